@@ -0,0 +1,533 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Cycle-accurate benchmark harness. Runs the real AVR image under simavr,
+// drives the joystick, keypad and sensors from a scenario script and
+// measures, instruction by instruction:
+//
+//   fn     inclusive cycles per call of the watched functions (interrupts
+//          taken inside a call are included, as they are on the part)
+//   self   cycles spent with the PC inside each function
+//   state  cycles per ss() call, by the state it was called with (the
+//          numbers are the state enum in main.c)
+//   isr    TIMER1_OVF latency, from the flag being raised to the first
+//          instruction of the handler
+//   stack  deepest stack pointer seen, in bytes below RAMEND
+//
+//   bench [-b baseline] [-w] [-p percent] [-f function]... leaf.elf leaf.sym scenario...
+//
+//   -b  compare with (or with -w write) this baseline file
+//   -w  write the baseline instead of comparing
+//   -p  allowed slowdown in percent before a metric counts as a regression
+//   -f  watch another function as well
+//
+// Scenarios use the same commands as the host simulator (host/sim.c):
+// joy, tap, key, press, adc, profile, plus "<time> end".
+// Exit status is 1 when any metric regressed against the baseline.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_interrupts.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_eeprom.h>
+
+#define BENCH_F_CPU 8000000UL
+#define BENCH_VCC_MV 5000
+#define BENCH_RAMEND 0x40FF
+#define BENCH_HOLD_MS 300
+#define BENCH_TIMER1_OVF 15			// vector number on the ATmega1284
+#define BENCH_MAX_FUNCS 512
+#define BENCH_MAX_WATCH 32
+#define BENCH_MAX_DEPTH 32
+#define BENCH_MAX_EVENTS 256
+#define BENCH_STATES 64
+#define BENCH_SLACK 4					// cycles of noise always allowed
+
+typedef struct Func {
+	uint32_t addr;
+	uint32_t size;
+	char name[48];
+	uint64_t self;
+	uint8_t watched;
+	uint32_t calls;
+	uint64_t total;
+	uint64_t max;
+} Func;
+
+typedef struct Stat {
+	uint32_t calls;
+	uint64_t total;
+	uint64_t max;
+} Stat;
+
+typedef struct Frame {
+	Func* f;
+	uint64_t start;
+	uint16_t sp;
+	int16_t state;
+} Frame;
+
+typedef struct Event {
+	uint64_t ms;
+	char cmd[16];
+	char arg[96];
+} Event;
+
+static const char* benchWatch[BENCH_MAX_WATCH] = {
+	"TimerISR", "__vector_15", "ss", "hourGlass", "reader",
+	"Menu_Step", "Menu_Enter", "LCD_DisplayString", "LCD_DisplayString_P",
+	"LCD_WriteCommand", "LCD_WriteData", "GetKeypadKey", "convertToDec",
+	"savePlantProfile", "retrievePlantProfile", "Profile_Put",
+	"Zone_Tick", "Zone_Sample", "History_Tick"
+};
+static unsigned benchWatchCount = 19;
+
+static Func benchFuncs[BENCH_MAX_FUNCS];
+static unsigned benchFuncCount;
+static Func* benchSs;
+static Func* benchIsr;
+
+// per scenario
+static avr_t* avr;
+static Frame benchStack[BENCH_MAX_DEPTH];
+static unsigned benchDepth;
+static Stat benchStates[BENCH_STATES];
+static Stat benchLatency;
+static uint64_t benchPendingAt;
+static uint8_t benchPending;
+static uint16_t benchMinSp;
+static uint64_t benchSleep;
+static char benchKey;
+static Event benchEvents[BENCH_MAX_EVENTS];
+static unsigned benchEventCount;
+
+// baseline
+static FILE* benchOut;
+static char* benchBase;
+static unsigned benchPercent = 2;
+static unsigned benchRegressions;
+
+static int bench_by_addr(const void* a, const void* b)
+{
+	const Func* x = a;
+	const Func* y = b;
+	return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+// Reads "avr-nm -S -n" output: address, size, type, name
+static void bench_load_symbols(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char line[160];
+	unsigned addr, size, i;
+	char type;
+	char name[48];
+	Func* fn;
+
+	if (!f) { perror(path); exit(2); }
+	while (fgets(line, sizeof(line), f) && benchFuncCount < BENCH_MAX_FUNCS) {
+		if (sscanf(line, "%x %x %c %47s", &addr, &size, &type, name) != 4) { continue; }
+		if (type != 'T' && type != 't' && type != 'W' && type != 'w') { continue; }
+		fn = &benchFuncs[benchFuncCount++];
+		fn->addr = addr;
+		fn->size = size;
+		snprintf(fn->name, sizeof(fn->name), "%s", name);
+	}
+	fclose(f);
+	qsort(benchFuncs, benchFuncCount, sizeof(Func), bench_by_addr);
+	for (i = 0; i < benchFuncCount; ++i) {
+		fn = &benchFuncs[i];
+		for (unsigned w = 0; w < benchWatchCount; ++w) {
+			if (!strcmp(fn->name, benchWatch[w])) { fn->watched = 1; }
+		}
+		if (!strcmp(fn->name, "ss")) { benchSs = fn; }
+		if (!strcmp(fn->name, "__vector_15")) { benchIsr = fn; }
+	}
+}
+
+static Func* bench_func_at(uint32_t pc)
+{
+	unsigned lo = 0, hi = benchFuncCount;
+	while (lo < hi) {
+		unsigned mid = (lo + hi) / 2;
+		if (benchFuncs[mid].addr <= pc) { lo = mid + 1; } else { hi = mid; }
+	}
+	if (lo == 0) { return 0; }
+	Func* f = &benchFuncs[lo - 1];
+	return (pc < f->addr + f->size) ? f : 0;
+}
+
+static uint64_t bench_parse_time(const char* s)
+{
+	char* end;
+	double v = strtod(s, &end);
+	if (!strcmp(end, "ms")) { return (uint64_t)v; }
+	if (!strcmp(end, "m")) { return (uint64_t)(v * 60000); }
+	if (!strcmp(end, "h")) { return (uint64_t)(v * 3600000); }
+	return (uint64_t)(v * 1000);
+}
+
+static void bench_load_scenario(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char line[160];
+	char when[32];
+	Event* e;
+	size_t n;
+	int used;
+
+	if (!f) { perror(path); exit(2); }
+	benchEventCount = 0;
+	while (fgets(line, sizeof(line), f) && benchEventCount < BENCH_MAX_EVENTS) {
+		line[strcspn(line, "#\r\n")] = '\0';
+		e = &benchEvents[benchEventCount];
+		if (sscanf(line, "%31s %15s %n", when, e->cmd, &used) < 2) { continue; }
+		e->ms = bench_parse_time(when);
+		snprintf(e->arg, sizeof(e->arg), "%s", line + used);
+		for (n = strlen(e->arg); n && (e->arg[n - 1] == ' ' || e->arg[n - 1] == '\t'); --n) {
+			e->arg[n - 1] = '\0';
+		}
+		++benchEventCount;
+	}
+	fclose(f);
+}
+
+/* ----------  INPUTS  ---------- */
+
+static void bench_adc(unsigned ch, unsigned count)
+{
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + ch),
+		(count * BENCH_VCC_MV + 512) / 1024);
+}
+
+static void bench_joystick(const char* dir)
+{
+	bench_adc(4, !strcmp(dir, "up") ? 0 : !strcmp(dir, "down") ? 1023 : 512);
+	bench_adc(5, !strcmp(dir, "left") ? 0 : !strcmp(dir, "right") ? 1023 : 512);
+}
+
+// Keypad matrix: a held key pulls its row (PB0-3) low while its column
+// (PB4-7) is driven low; every other row reads high through the pull-up.
+static void bench_keypad(struct avr_irq_t* irq, uint32_t port, void* param)
+{
+	static const char keys[4][4] = {
+		{ '1', '2', '3', 'A' },
+		{ '4', '5', '6', 'B' },
+		{ '7', '8', '9', 'C' },
+		{ '*', '0', '#', 'D' }
+	};
+	unsigned r, c, low;
+	(void)irq;
+	(void)param;
+	for (r = 0; r < 4; ++r) {
+		low = 0;
+		for (c = 0; c < 4; ++c) {
+			if (benchKey == keys[r][c] && !(port & (0x10 << c))) { low = 1; }
+		}
+		avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), IOPORT_IRQ_PIN0 + r), !low);
+	}
+}
+
+static void bench_profile(const char* arg)
+{
+	unsigned slot, day, freq, ms, sun;
+	uint8_t p[6];
+	avr_eeprom_desc_t d;
+
+	if (sscanf(arg, "%u %u %u %u %u", &slot, &day, &freq, &ms, &sun) != 5 || slot < 1 || slot > 4) {
+		fprintf(stderr, "bench: bad profile '%s'\n", arg);
+		return;
+	}
+	// PlantProfile in profile.h: day, frequency, moisture, sun; 6 bytes from address 1
+	p[0] = day;
+	p[1] = freq;
+	p[2] = ms & 0xFF;
+	p[3] = ms >> 8;
+	p[4] = sun & 0xFF;
+	p[5] = sun >> 8;
+	d.ee = p;
+	d.offset = 1 + (slot - 1) * 6;
+	d.size = sizeof(p);
+	avr_ioctl(avr, AVR_IOCTL_EEPROM_SET, &d);
+}
+
+// Returns the cycle the held input is released at, 0 if it stays
+static uint64_t bench_event(const Event* e)
+{
+	unsigned ch, v;
+	uint64_t hold = (uint64_t)BENCH_HOLD_MS * (BENCH_F_CPU / 1000);
+
+	if (!strcmp(e->cmd, "joy")) { bench_joystick(e->arg); }
+	else if (!strcmp(e->cmd, "tap")) { bench_joystick(e->arg); return avr->cycle + hold; }
+	else if (!strcmp(e->cmd, "key")) { benchKey = strcmp(e->arg, "none") ? e->arg[0] : '\0'; }
+	else if (!strcmp(e->cmd, "press")) { benchKey = e->arg[0]; return avr->cycle + hold; }
+	else if (!strcmp(e->cmd, "adc") && sscanf(e->arg, "%u %u", &ch, &v) == 2 && ch < 8) { bench_adc(ch, v); }
+	else if (!strcmp(e->cmd, "profile")) { bench_profile(e->arg); }
+	else if (strcmp(e->cmd, "end")) { fprintf(stderr, "bench: unknown command '%s'\n", e->cmd); }
+	return 0;
+}
+
+/* ----------  MEASUREMENT  ---------- */
+
+static void bench_pending(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+	(void)irq;
+	(void)param;
+	if (value && !benchPending) {
+		benchPending = 1;
+		benchPendingAt = avr->cycle;
+	}
+}
+
+static void bench_stat(Stat* s, uint64_t cycles)
+{
+	++s->calls;
+	s->total += cycles;
+	if (cycles > s->max) { s->max = cycles; }
+}
+
+static uint16_t bench_sp(void)
+{
+	return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+}
+
+static void bench_step(void)
+{
+	uint32_t pc = avr->pc;
+	uint64_t before = avr->cycle;
+	uint16_t sp;
+	Frame* fr;
+	Func* f;
+
+	avr_run(avr);
+	if (avr->state == cpu_Sleeping && avr->pc == pc) {
+		benchSleep += avr->cycle - before;
+	}
+	else if ((f = bench_func_at(pc))) {
+		f->self += avr->cycle - before;
+	}
+
+	sp = bench_sp();
+	if (sp < benchMinSp) { benchMinSp = sp; }
+
+	// a return pops the return address, leaving SP above the entry value
+	while (benchDepth && sp > benchStack[benchDepth - 1].sp) {
+		fr = &benchStack[--benchDepth];
+		uint64_t cycles = avr->cycle - fr->start;
+		++fr->f->calls;
+		fr->f->total += cycles;
+		if (cycles > fr->f->max) { fr->f->max = cycles; }
+		if (fr->state >= 0 && fr->state < BENCH_STATES) { bench_stat(&benchStates[fr->state], cycles); }
+	}
+
+	if (avr->pc != pc && (f = bench_func_at(avr->pc)) && f->addr == avr->pc) {
+		if (f == benchIsr && benchPending) {
+			bench_stat(&benchLatency, avr->cycle - benchPendingAt);
+			benchPending = 0;
+		}
+		if (f->watched && benchDepth < BENCH_MAX_DEPTH) {
+			fr = &benchStack[benchDepth++];
+			fr->f = f;
+			fr->start = avr->cycle;
+			fr->sp = sp;
+			fr->state = (f == benchSs) ? (int16_t)avr->data[24] : -1;	// first argument in r24
+		}
+	}
+}
+
+/* ----------  REPORT  ---------- */
+
+// Compares one metric with the baseline, or records it with -w
+static void bench_metric(const char* scenario, const char* key, uint64_t value)
+{
+	char want[128];
+	const char* hit;
+	unsigned long long base;
+	uint64_t limit;
+
+	printf("  %-32s %10llu", key, (unsigned long long)value);
+	if (benchOut) {
+		fprintf(benchOut, "%s %s %llu\n", scenario, key, (unsigned long long)value);
+	}
+	else if (benchBase) {
+		snprintf(want, sizeof(want), "\n%s %s ", scenario, key);
+		if ((hit = strstr(benchBase, want)) && sscanf(hit + strlen(want), "%llu", &base) == 1) {
+			limit = base + base * benchPercent / 100 + BENCH_SLACK;
+			printf("  (baseline %llu)", base);
+			if (value > limit) {
+				printf("  REGRESSION");
+				++benchRegressions;
+			}
+		}
+		else {
+			printf("  (new)");
+		}
+	}
+	printf("\n");
+}
+
+static void bench_report(const char* scenario)
+{
+	char key[96];
+	unsigned i;
+	Func* f;
+
+	printf("%s\n", scenario);
+	for (i = 0; i < benchFuncCount; ++i) {
+		f = &benchFuncs[i];
+		if (!f->watched || !f->calls) { continue; }
+		snprintf(key, sizeof(key), "fn.%s.mean", f->name);
+		bench_metric(scenario, key, f->total / f->calls);
+		snprintf(key, sizeof(key), "fn.%s.max", f->name);
+		bench_metric(scenario, key, f->max);
+	}
+	for (i = 0; i < BENCH_STATES; ++i) {
+		if (!benchStates[i].calls) { continue; }
+		snprintf(key, sizeof(key), "state.%u.max", i);
+		bench_metric(scenario, key, benchStates[i].max);
+	}
+	if (benchLatency.calls) {
+		bench_metric(scenario, "isr.TIMER1_OVF.latency.mean", benchLatency.total / benchLatency.calls);
+		bench_metric(scenario, "isr.TIMER1_OVF.latency.max", benchLatency.max);
+	}
+	bench_metric(scenario, "stack.peak", BENCH_RAMEND - benchMinSp);
+
+	printf("  self cycles (informational)\n");
+	for (i = 0; i < benchFuncCount; ++i) {
+		f = &benchFuncs[i];
+		if (f->self) { printf("    %-30s %12llu\n", f->name, (unsigned long long)f->self); }
+	}
+	printf("    %-30s %12llu\n", "<sleep>", (unsigned long long)benchSleep);
+}
+
+static void bench_run(const char* elf, const char* path)
+{
+	elf_firmware_t fw;
+	uint64_t end, at, release = 0;
+	unsigned next = 0, i;
+	const char* name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	char scenario[64];
+
+	snprintf(scenario, sizeof(scenario), "%.*s", (int)strcspn(name, "."), name);
+	bench_load_scenario(path);
+
+	memset(&fw, 0, sizeof(fw));
+	if (elf_read_firmware(elf, &fw)) { fprintf(stderr, "bench: cannot read %s\n", elf); exit(2); }
+	avr = avr_make_mcu_by_name("atmega1284");
+	if (!avr) { fprintf(stderr, "bench: simavr has no atmega1284\n"); exit(2); }
+	avr_init(avr);
+	avr_load_firmware(avr, &fw);
+	avr->frequency = BENCH_F_CPU;
+	avr->avcc = avr->aref = BENCH_VCC_MV;
+	avr->log = LOG_WARNING;
+
+	for (i = 0; i < benchFuncCount; ++i) {
+		benchFuncs[i].self = benchFuncs[i].calls = benchFuncs[i].total = benchFuncs[i].max = 0;
+	}
+	memset(benchStates, 0, sizeof(benchStates));
+	memset(&benchLatency, 0, sizeof(benchLatency));
+	benchDepth = 0;
+	benchPending = 0;
+	benchMinSp = BENCH_RAMEND;
+	benchSleep = 0;
+	benchKey = '\0';
+
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), IOPORT_IRQ_REG_PORT), bench_keypad, 0);
+	avr_irq_register_notify(avr_get_interrupt_irq(avr, BENCH_TIMER1_OVF) + AVR_INT_IRQ_PENDING, bench_pending, 0);
+	bench_joystick("center");
+	for (i = 6; i < 8; ++i) { bench_adc(i, 512); }
+	bench_keypad(0, 0xFF, 0);
+
+	// the run ends at "end", or two seconds after the last event
+	end = benchEventCount ? benchEvents[benchEventCount - 1].ms + 2000 : 10000;
+	for (i = 0; i < benchEventCount; ++i) {
+		if (!strcmp(benchEvents[i].cmd, "end")) { end = benchEvents[i].ms; }
+	}
+	end *= BENCH_F_CPU / 1000;
+
+	while (next < benchEventCount && benchEvents[next].ms == 0) { bench_event(&benchEvents[next++]); }
+	while (avr->cycle < end && avr->state != cpu_Done && avr->state != cpu_Crashed) {
+		at = (next < benchEventCount) ? benchEvents[next].ms * (BENCH_F_CPU / 1000) : UINT64_MAX;
+		if (avr->cycle >= at) {
+			uint64_t r = bench_event(&benchEvents[next++]);
+			if (r) { release = r; }
+		}
+		if (release && avr->cycle >= release) {
+			release = 0;
+			bench_joystick("center");
+			benchKey = '\0';
+		}
+		bench_step();
+	}
+	if (avr->state == cpu_Crashed) { fprintf(stderr, "bench: %s: firmware crashed at pc 0x%x\n", scenario, avr->pc); }
+
+	bench_report(scenario);
+	avr_terminate(avr);
+}
+
+static char* bench_read_file(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char* buf;
+	long n;
+
+	if (!f) { return 0; }
+	fseek(f, 0, SEEK_END);
+	n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = malloc(n + 2);
+	buf[0] = '\n';				// so every line can be matched as "\n<scenario> <key> "
+	n = fread(buf + 1, 1, n, f);
+	buf[n + 1] = '\0';
+	fclose(f);
+	return buf;
+}
+
+int main(int argc, char** argv)
+{
+	const char* baseline = 0;
+	const char* elf = 0;
+	const char* sym = 0;
+	int write = 0;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+		if (!strcmp(argv[i], "-b") && i + 1 < argc) { baseline = argv[++i]; }
+		else if (!strcmp(argv[i], "-w")) { write = 1; }
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc) { benchPercent = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-f") && i + 1 < argc && benchWatchCount < BENCH_MAX_WATCH) {
+			benchWatch[benchWatchCount++] = argv[++i];
+		}
+		else { break; }
+	}
+	if (argc - i < 3) {
+		fprintf(stderr, "usage: %s [-b baseline] [-w] [-p percent] [-f function]... leaf.elf leaf.sym scenario...\n", argv[0]);
+		return 2;
+	}
+	elf = argv[i++];
+	sym = argv[i++];
+	bench_load_symbols(sym);
+
+	if (baseline && write) {
+		if (!(benchOut = fopen(baseline, "w"))) { perror(baseline); return 2; }
+	}
+	else if (baseline && !(benchBase = bench_read_file(baseline))) {
+		fprintf(stderr, "bench: no baseline %s yet, reporting only\n", baseline);
+	}
+
+	for (; i < argc; ++i) { bench_run(elf, argv[i]); }
+
+	if (benchOut) { fclose(benchOut); }
+	if (benchRegressions) {
+		printf("%u metric(s) slower than the baseline\n", benchRegressions);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,344 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Serial bootloader for field updates, linked into the boot section
+// (BOOT_START, see the Makefile) and entered on every reset. The protocol
+// and the hand-off from the application are described in headers/update.h.
+//
+// It stays in update mode while an upload is under way or when there is no
+// application. When the application asked for an update it waits for an
+// UPDATE_SYNC frame for BOOT_REQUEST_MS, and after a reset from the reset pin
+// for BOOT_WINDOW_MS. Anything else goes straight to the application,
+// leaving MCUSR and the watchdog as they were, so warm restarts (warm.h)
+// still see the watchdog reset.
+//
+// Receiving and flashing overlap. Two page buffers alternate: while one is
+// written to the RWW section the other receives the next frame, and the boot
+// section, being NRWW, keeps running meanwhile. The flash work is broken into
+// steps of a few dozen cycles (one word into the page buffer, one byte of
+// verify, starting an erase or write) and the USART is polled between steps,
+// so no byte is lost at UPDATE_BAUD without using interrupts.
+//
+// The bootloader has no .data or .bss: its state is a local of main(), on
+// the stack at the top of SRAM. The C startup therefore does not clear any
+// SRAM, and the application's .noinit warm restart block survives the
+// pass-through.
+
+#include <avr/io.h>
+#include <avr/boot.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
+#include "board.h"					// F_CPU and CONSOLE_USART, ahead of delay.h
+#include <util/delay.h>
+#include "update.h"
+
+// Bootloader Setup Values
+#ifndef BOOT_START
+#define BOOT_START 0x1F000UL			// byte address, BOOTSZ = 01 (2048 words)
+#endif
+#define BOOT_WINDOW_MS 200				// listen this long after a reset pin reset
+#define BOOT_REQUEST_MS 5000			// and this long after the application asked
+#define BOOT_APP_PAGES (BOOT_START / SPM_PAGESIZE)
+#define BOOT_UBRR (F_CPU / 8 / UPDATE_BAUD - 1)
+
+// The register bits sit at the same positions in both USARTs
+#if CONSOLE_USART == 1
+#define BOOT_UCSRA UCSR1A
+#define BOOT_UCSRB UCSR1B
+#define BOOT_UCSRC UCSR1C
+#define BOOT_UBRR_REG UBRR1
+#define BOOT_UDR   UDR1
+#else
+#define BOOT_UCSRA UCSR0A
+#define BOOT_UCSRB UCSR0B
+#define BOOT_UCSRC UCSR0C
+#define BOOT_UBRR_REG UBRR0
+#define BOOT_UDR   UDR0
+#endif
+
+// Receiver states
+enum { RX_SOF, RX_CMD, RX_ARG_LO, RX_ARG_HI, RX_DATA, RX_CRC_LO, RX_CRC_HI };
+
+// Flash job steps, in order
+enum { JOB_IDLE, JOB_FILL, JOB_ERASE, JOB_WRITE, JOB_ENABLE, JOB_VERIFY };
+
+typedef struct Loader {
+	unsigned char buf[2][SPM_PAGESIZE];
+	unsigned char rxBuf;				// buffer the receiver fills
+	unsigned char rx;					// RX_ state
+	unsigned char cmd;
+	unsigned short arg;
+	unsigned short at;					// data bytes received
+	unsigned short crc;
+	unsigned char crcLo;
+	unsigned char job;					// JOB_ step
+	unsigned char jobBuf;
+	unsigned short jobPage;
+	unsigned short jobAt;
+	unsigned short pages;				// pages taken so far, the next one expected
+	unsigned char failed;
+	unsigned char synced;				// an UPDATE_SYNC was answered
+} Loader;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sets up the console USART for the update baud rate
+//Parameter: None
+//Returns: None
+static void Loader_UsartOn()
+{
+	BOOT_UBRR_REG = BOOT_UBRR;
+	BOOT_UCSRA = (1 << U2X1);
+	BOOT_UCSRC = (1 << UCSZ11) | (1 << UCSZ10);
+	BOOT_UCSRB = (1 << RXEN1) | (1 << TXEN1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Puts the USART back to its reset state for the application,
+//				  whose init ORs its own bits in
+//Parameter: 1 to let the last byte sent go out first
+//Returns: None
+static void Loader_UsartOff(unsigned char drain)
+{
+	if (drain) { while (!(BOOT_UCSRA & (1 << TXC1))) {} }
+	BOOT_UCSRB = 0;
+	BOOT_UCSRA = (1 << TXC1);			// clears TXC and U2X
+	BOOT_UCSRC = (1 << UCSZ11) | (1 << UCSZ10);
+	BOOT_UBRR_REG = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends one byte
+//Parameter: The byte
+//Returns: None
+static void Loader_Send(unsigned char c)
+{
+	while (!(BOOT_UCSRA & (1 << UDRE1))) {}
+	BOOT_UCSRA = (1 << TXC1) | (1 << U2X1);	// clear TXC, so it marks the end of this byte
+	BOOT_UDR = c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts the application with the bootloader out of the way
+//Parameter: 1 if a byte was sent that must go out first
+//Returns: None
+static void Loader_Leave(unsigned char drain)
+{
+	Loader_UsartOff(drain);
+	boot_rww_enable_safe();
+	((void (*)(void))0)();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Does one step of the running flash job, if the SPM unit is free
+//Parameter: The loader
+//Returns: None
+static void Loader_Step(Loader* l)
+{
+	unsigned long addr = (unsigned long)l->jobPage * SPM_PAGESIZE;
+	const unsigned char* b = l->buf[l->jobBuf];
+
+	if (l->job == JOB_IDLE || boot_spm_busy()) { return; }
+	switch (l->job) {
+		case JOB_FILL:					// the page buffer may be filled before the erase
+			boot_page_fill(addr + l->jobAt, b[l->jobAt] | (b[l->jobAt + 1] << 8));
+			l->jobAt += 2;
+			if (l->jobAt == SPM_PAGESIZE) { l->job = JOB_ERASE; }
+			break;
+		case JOB_ERASE:
+			boot_page_erase(addr);
+			l->job = JOB_WRITE;
+			break;
+		case JOB_WRITE:
+			boot_page_write(addr);
+			l->job = JOB_ENABLE;
+			break;
+		case JOB_ENABLE:
+			boot_rww_enable();
+			l->jobAt = 0;
+			l->job = JOB_VERIFY;
+			break;
+		case JOB_VERIFY:
+			if (pgm_read_byte_far(addr + l->jobAt) != b[l->jobAt]) { l->failed = 1; }
+			if (++l->jobAt == SPM_PAGESIZE) { l->job = JOB_IDLE; }
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Runs the flash job to the end; the host is waiting for an
+//				  answer then, so nothing arrives meanwhile
+//Parameter: The loader
+//Returns: None
+static void Loader_Finish(Loader* l)
+{
+	while (l->job != JOB_IDLE) { Loader_Step(l); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Acts on a complete frame
+//Parameter: The loader and whether its CRC matched
+//Returns: None
+static void Loader_Frame(Loader* l, unsigned char ok)
+{
+	if (!ok) {
+		Loader_Send(UPDATE_NAK);
+		return;
+	}
+	switch (l->cmd) {
+		case UPDATE_SYNC:				// (re)starts an upload
+			Loader_Finish(l);
+			// the application is about to be overwritten: until UPDATE_END,
+			// every reset has to come back here, however the upload began
+			if (eeprom_read_byte(UPDATE_EE_REQUEST) != UPDATE_FLASHING) {
+				eeprom_write_byte(UPDATE_EE_REQUEST, UPDATE_FLASHING);
+				eeprom_busy_wait();
+			}
+			l->pages = 0;
+			l->failed = 0;
+			l->synced = 1;
+			Loader_Send(UPDATE_ACK);
+			Loader_Send((unsigned char)BOOT_APP_PAGES);
+			Loader_Send((unsigned char)(BOOT_APP_PAGES >> 8));
+			break;
+		case UPDATE_PAGE:
+			Loader_Finish(l);
+			// pages come in order; the last one again means its ACK was
+			// lost, and it is programmed again without being counted
+			if (l->failed || l->arg >= BOOT_APP_PAGES || (l->arg != l->pages && l->arg + 1 != l->pages)) {
+				l->failed = 1;
+				Loader_Send(UPDATE_FAIL);
+				break;
+			}
+			if (l->arg == l->pages) { ++l->pages; }
+			l->jobBuf = l->rxBuf;
+			l->jobPage = l->arg;
+			l->jobAt = 0;
+			l->job = JOB_FILL;
+			l->rxBuf ^= 1;
+			Loader_Send(UPDATE_ACK);
+			break;
+		case UPDATE_END:
+			Loader_Finish(l);
+			if (l->failed || l->pages != l->arg) {
+				Loader_Send(UPDATE_FAIL);
+				break;
+			}
+			eeprom_write_byte(UPDATE_EE_REQUEST, 0xFF);
+			eeprom_busy_wait();
+			Loader_Send(UPDATE_ACK);
+			MCUSR = 0;					// the new application starts cold
+			Loader_Leave(1);
+			break;
+		default:
+			Loader_Send(UPDATE_NAK);
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Feeds one received byte to the frame decoder
+//Parameter: The loader and the byte
+//Returns: None
+static void Loader_Rx(Loader* l, unsigned char c)
+{
+	switch (l->rx) {
+		case RX_SOF:
+			if (c == UPDATE_SOF) {
+				l->crc = 0;
+				l->rx = RX_CMD;
+			}
+			return;
+		case RX_CMD:
+			l->cmd = c;
+			l->rx = RX_ARG_LO;
+			break;
+		case RX_ARG_LO:
+			l->arg = c;
+			l->rx = RX_ARG_HI;
+			break;
+		case RX_ARG_HI:
+			l->arg |= (unsigned short)c << 8;
+			l->at = 0;
+			l->rx = (l->cmd == UPDATE_PAGE) ? RX_DATA : RX_CRC_LO;
+			break;
+		case RX_DATA:
+			l->buf[l->rxBuf][l->at] = c;
+			if (++l->at == SPM_PAGESIZE) { l->rx = RX_CRC_LO; }
+			break;
+		case RX_CRC_LO:
+			l->crcLo = c;
+			l->rx = RX_CRC_HI;
+			return;
+		case RX_CRC_HI:
+			l->rx = RX_SOF;
+			Loader_Frame(l, l->crc == (l->crcLo | ((unsigned short)c << 8)));
+			return;
+	}
+	l->crc = _crc_xmodem_update(l->crc, c);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Waits for an UPDATE_SYNC frame and answers it
+//Parameter: The loader and how long to wait, in ms
+//Returns: 1 if one arrived, else 0
+static unsigned char Loader_Listen(Loader* l, unsigned short ms)
+{
+	unsigned long n;
+	for (n = 0; n < ms * 100UL; ++n) {
+		if (BOOT_UCSRA & (1 << RXC1)) {
+			Loader_Rx(l, BOOT_UDR);
+			if (l->synced) { return 1; }
+		}
+		_delay_us(10);					// under one byte time, so the rest of the frame is not lost
+	}
+	return 0;
+}
+
+int main(void)
+{
+	Loader l;
+	unsigned char flag = eeprom_read_byte(UPDATE_EE_REQUEST);
+	unsigned char empty = (pgm_read_word_far(0) == 0xFFFF);
+
+	l.rx = RX_SOF;
+	l.rxBuf = 0;
+	l.job = JOB_IDLE;
+	l.pages = 0;
+	l.failed = 0;
+	l.synced = 0;
+
+	if (flag == UPDATE_REQUEST && !empty) {
+		// the request came by a watchdog reset, and WDRF keeps the watchdog
+		// on at its shortest timeout: it would cut the wait short
+		MCUSR &= ~(1 << WDRF);
+		wdt_disable();
+		Loader_UsartOn();
+		if (!Loader_Listen(&l, BOOT_REQUEST_MS)) {
+			// nobody came: the application is whole, so carry on watering
+			eeprom_write_byte(UPDATE_EE_REQUEST, 0xFF);
+			eeprom_busy_wait();
+			MCUSR = 0;
+			Loader_Leave(0);
+		}
+	}
+	else if (flag != UPDATE_FLASHING && !empty) {
+		if (!(MCUSR & (1 << EXTRF))) { Loader_Leave(0); }
+		Loader_UsartOn();
+		if (!Loader_Listen(&l, BOOT_WINDOW_MS)) { Loader_Leave(0); }
+	}
+	else {
+		Loader_UsartOn();
+	}
+
+	// updating: the application's warm state is of no use any more
+	MCUSR = 0;
+	wdt_disable();
+	for (;;) {
+		if (BOOT_UCSRA & (1 << RXC1)) { Loader_Rx(&l, BOOT_UDR); }
+		Loader_Step(&l);
+	}
+}
@@ -0,0 +1,266 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host side of the field update (Linux). Reads an Intel HEX image, asks the
+// running firmware for an update on the console ("UPGRADE" at the console
+// baud rate), then talks to the bootloader at UPDATE_BAUD: one frame per
+// flash page, the next one sent as soon as the previous is acknowledged, so
+// the link and the flash programming overlap. A board without a working
+// application can be updated as well: the bootloader waits for it, or listens
+// for 200 ms after the reset button.
+//
+//   upload [-b 9600] [-n] /dev/ttyUSB0 leaf.hex
+//
+//   -b  console baud rate of the running firmware
+//   -n  do not send "UPGRADE" first (the bootloader is already waiting)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/select.h>
+
+// Mirrors headers/update.h
+#define UPDATE_SOF  0xA5
+#define UPDATE_SYNC 'S'
+#define UPDATE_PAGE 'P'
+#define UPDATE_END  'E'
+#define UPDATE_ACK  0x06
+#define UPDATE_NAK  0x15
+#define UPDATE_FAIL 'F'
+
+#define UP_PAGE 256						// SPM_PAGESIZE of the ATmega1284
+#define UP_FLASH (128 * 1024)
+#define UP_RETRIES 5
+#define UP_SYNC_MS 3000					// keep trying to sync this long
+#define UP_ANSWER_MS 200				// a page takes under 10 ms to program
+
+static unsigned char upImage[UP_FLASH];
+static int upFd = -1;
+
+static double up_now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int up_hex(int c)
+{
+	if (c >= '0' && c <= '9') { return c - '0'; }
+	if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+	if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+	return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Loads an Intel HEX file into upImage (blank is 0xFF)
+//Parameter: The file name
+//Returns: Bytes up to the highest address written, or -1 on error
+static long up_load_hex(const char* name)
+{
+	FILE* f = fopen(name, "r");
+	char line[600];
+	unsigned char rec[256 + 5];
+	unsigned long base = 0, addr;
+	long top = 0;
+	int n, i, hi, lo;
+	unsigned char sum;
+
+	if (!f) {
+		perror(name);
+		return -1;
+	}
+	memset(upImage, 0xFF, sizeof(upImage));
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] != ':') { continue; }
+		for (n = 0, sum = 0; n < (int)sizeof(rec); ++n) {
+			hi = up_hex(line[1 + n * 2]);
+			lo = up_hex(line[2 + n * 2]);
+			if (hi < 0 || lo < 0) { break; }
+			rec[n] = hi << 4 | lo;
+			sum += rec[n];
+		}
+		if (n < 5 || n != rec[0] + 5 || sum) {
+			fprintf(stderr, "upload: bad record in %s: %s", name, line);
+			fclose(f);
+			return -1;
+		}
+		addr = base + (rec[1] << 8 | rec[2]);
+		switch (rec[3]) {
+			case 0:
+				if (addr + rec[0] > UP_FLASH) {
+					fprintf(stderr, "upload: %s does not fit the flash\n", name);
+					fclose(f);
+					return -1;
+				}
+				for (i = 0; i < rec[0]; ++i) { upImage[addr + i] = rec[4 + i]; }
+				if ((long)(addr + rec[0]) > top) { top = addr + rec[0]; }
+				break;
+			case 2: base = (unsigned long)(rec[4] << 8 | rec[5]) << 4; break;
+			case 4: base = (unsigned long)(rec[4] << 8 | rec[5]) << 16; break;
+			default: break;				// end of file, start addresses
+		}
+	}
+	fclose(f);
+	return top;
+}
+
+static speed_t up_speed(long baud)
+{
+	switch (baud) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 500000: return B500000;
+		default: return B0;
+	}
+}
+
+static int up_baud(long baud)
+{
+	struct termios t;
+	if (tcgetattr(upFd, &t)) { return -1; }
+	cfmakeraw(&t);
+	t.c_cflag |= CLOCAL | CREAD;
+	t.c_cflag &= ~(CSTOPB | CRTSCTS);
+	cfsetispeed(&t, up_speed(baud));
+	cfsetospeed(&t, up_speed(baud));
+	return tcsetattr(upFd, TCSANOW, &t);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads one byte within a timeout
+//Parameter: Timeout in ms
+//Returns: The byte, or -1 on timeout
+static int up_read(int ms)
+{
+	fd_set set;
+	struct timeval tv;
+	unsigned char c;
+
+	FD_ZERO(&set);
+	FD_SET(upFd, &set);
+	tv.tv_sec = ms / 1000;
+	tv.tv_usec = (ms % 1000) * 1000;
+	if (select(upFd + 1, &set, 0, 0, &tv) <= 0 || read(upFd, &c, 1) != 1) { return -1; }
+	return c;
+}
+
+static unsigned short up_crc(unsigned short crc, unsigned char c)
+{
+	int i;
+	crc ^= (unsigned short)c << 8;
+	for (i = 0; i < 8; ++i) { crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1; }
+	return crc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends one frame and waits for its answer, sending it again
+//				  on a NAK or no answer
+//Parameter: Command, argument and page data (0 for none)
+//Returns: UPDATE_ACK, UPDATE_FAIL or -1 if the bootloader did not answer
+static int up_frame(unsigned char cmd, unsigned short arg, const unsigned char* data, int answerMs)
+{
+	unsigned char f[4 + UP_PAGE + 2];
+	unsigned short crc = 0;
+	int n = 0, i, r, tries;
+
+	f[n++] = UPDATE_SOF;
+	f[n++] = cmd;
+	f[n++] = arg & 0xFF;
+	f[n++] = arg >> 8;
+	if (data) {
+		memcpy(f + n, data, UP_PAGE);
+		n += UP_PAGE;
+	}
+	for (i = 1; i < n; ++i) { crc = up_crc(crc, f[i]); }
+	f[n++] = crc & 0xFF;
+	f[n++] = crc >> 8;
+
+	for (tries = 0; tries < UP_RETRIES; ++tries) {
+		if (write(upFd, f, n) != n) { return -1; }
+		r = up_read(answerMs);
+		if (r == UPDATE_ACK || r == UPDATE_FAIL) { return r; }
+		tcflush(upFd, TCIFLUSH);		// NAK, noise or nothing: try again
+	}
+	return -1;
+}
+
+int main(int argc, char** argv)
+{
+	long console = 9600, size;
+	int request = 1, i, r, lo, hi;
+	unsigned pages, appPages, p;
+	double start, until;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+		if (!strcmp(argv[i], "-b") && i + 1 < argc) { console = atol(argv[++i]); }
+		else if (!strcmp(argv[i], "-n")) { request = 0; }
+		else { break; }
+	}
+	if (argc - i != 2 || up_speed(console) == B0) {
+		fprintf(stderr, "usage: %s [-b 9600] [-n] /dev/ttyUSB0 leaf.hex\n", argv[0]);
+		return 2;
+	}
+	if ((size = up_load_hex(argv[i + 1])) <= 0) { return 1; }
+	pages = (size + UP_PAGE - 1) / UP_PAGE;
+
+	upFd = open(argv[i], O_RDWR | O_NOCTTY);
+	if (upFd < 0) {
+		perror(argv[i]);
+		return 1;
+	}
+	start = up_now();
+	if (request) {
+		up_baud(console);
+		if (write(upFd, "UPGRADE", 7) != 7) {
+			perror(argv[i]);
+			return 1;
+		}
+		tcdrain(upFd);
+		usleep(100000);					// the watchdog resets the part after 15 ms
+	}
+	up_baud(500000);
+	tcflush(upFd, TCIOFLUSH);
+
+	until = up_now() + UP_SYNC_MS / 1000.0;
+	do {
+		r = up_frame(UPDATE_SYNC, 0, 0, 50);
+	} while (r != UPDATE_ACK && up_now() < until);
+	lo = up_read(UP_ANSWER_MS);
+	hi = up_read(UP_ANSWER_MS);
+	if (r != UPDATE_ACK || lo < 0 || hi < 0) {
+		fprintf(stderr, "upload: no answer from the bootloader\n");
+		return 1;
+	}
+	appPages = lo | hi << 8;
+	if (pages > appPages) {
+		fprintf(stderr, "upload: image is %u pages, the application section only %u\n", pages, appPages);
+		return 1;
+	}
+
+	for (p = 0; p < pages; ++p) {
+		r = up_frame(UPDATE_PAGE, p, upImage + p * UP_PAGE, UP_ANSWER_MS);
+		if (r != UPDATE_ACK) {
+			fprintf(stderr, "\nupload: page %u %s, run the upload again\n", p, (r == UPDATE_FAIL) ? "failed" : "not answered");
+			return 1;
+		}
+		fprintf(stderr, "\rpage %u/%u", p + 1, pages);
+	}
+	r = up_frame(UPDATE_END, pages, 0, UP_ANSWER_MS);
+	if (r != UPDATE_ACK) {
+		fprintf(stderr, "\nupload: the image did not verify, run the upload again\n");
+		return 1;
+	}
+	fprintf(stderr, "\n%ld bytes in %u pages, %.1f s\n", size, pages, up_now() - start);
+	close(upFd);
+	return 0;
+}
@@ -0,0 +1,267 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Display servant for boards built with DISPLAY_REMOTE (headers/display.h).
+// It owns the LCD, keypad and joystick and serves them to the main
+// controller as its SPI servant.
+//
+// The SPI interrupt decodes the frames into a copy of the screen and marks
+// the cells that changed; the main loop writes marked cells to the LCD at
+// the LCD's own pace and scans the inputs in between, so the master never
+// waits on the display. A frame arriving while cells are being written just
+// marks them again. Glyph patterns (glyph.h) go into CGRAM ahead of the cells
+// and the display shift (viewport.h) follows them.
+//
+// A clear only counts a generation in the interrupt. Each cell remembers the
+// generation it was written in, and one from an older generation reads as
+// blank. The main loop clears the LCD when it sees a new generation and
+// marks that generation's cells again, and it does not write a cell of a
+// generation it has not cleared for yet, so the clear never erases newer
+// cells.
+//
+// Pins (from the Makefile, see board.h): SPI takes PB4-7, so the keypad moves
+// to PORTC, the LCD data bus to PORTD and RS and E to PB0 and PB1; the
+// joystick stays on ADC4 and ADC5.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include "board.h"
+#include "bit.h"
+#include "spi.h"
+#include "keypad.h"
+#include "adc.h"
+#include "io.h"
+#include "display.h"
+
+// Mirrors DIR_ in headers/menu.h
+enum { DIR_NONE, DIR_UP, DIR_DOWN, DIR_LEFT, DIR_RIGHT };
+
+// Frame decoder states
+enum { RX_OP, RX_AT, RX_COUNT, RX_CELLS, RX_GOTO, RX_SLOT, RX_ROWS, RX_SHIFT, RX_SKIP };
+
+unsigned char cells[DISPLAY_CELLS];
+unsigned char cellGen[DISPLAY_CELLS];			// clearGen when the cell was written
+volatile unsigned char dirty[DISPLAY_CELLS];	// cells still to be written to the LCD
+volatile unsigned char cursor;					// cell the cursor goes to when done, up to 80
+volatile unsigned char shift;					// display shift to end up with
+unsigned char glyphs[GLYPH_SLOTS][8];
+volatile unsigned char glyphDirty[GLYPH_SLOTS];	// CGRAM slots still to be written
+volatile unsigned char clearGen;				// clears received, wrapping
+volatile unsigned char lost = 1;				// no clear received since the reset
+volatile unsigned char input;					// DISPLAY_IN() of the inputs now
+
+unsigned char rx;
+unsigned char rxAt;
+unsigned char rxLeft;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Takes one byte of a frame and loads the input state to go
+//				  out with the next
+ISR(SPI_STC_vect)
+{
+	unsigned char c = SPDR;
+	unsigned char old;
+
+	switch (rx) {
+		case RX_OP:
+			if (c == DISPLAY_OP_CLEAR) {
+				++clearGen;
+				cursor = 0;
+				shift = 0;
+				lost = 0;
+			}
+			else if (c == DISPLAY_OP_CELLS) { rx = RX_AT; }
+			else if (c == DISPLAY_OP_GOTO) { rx = RX_GOTO; }
+			else if (c == DISPLAY_OP_GLYPH) { rx = RX_SLOT; }
+			else if (c == DISPLAY_OP_SHIFT) { rx = RX_SHIFT; }
+			else if (c != DISPLAY_OP_NOP) { rx = RX_SKIP; }
+			break;
+		case RX_AT:
+			rxAt = c;
+			rx = RX_COUNT;
+			break;
+		case RX_COUNT:
+			rxLeft = c;
+			rx = rxLeft ? RX_CELLS : RX_OP;
+			break;
+		case RX_CELLS:
+			if (rxAt < DISPLAY_CELLS) {
+				old = (cellGen[rxAt] == clearGen) ? cells[rxAt] : ' ';
+				if (old != c) {
+					cells[rxAt] = c;
+					cellGen[rxAt] = clearGen;
+					dirty[rxAt] = 1;
+				}
+			}
+			++rxAt;
+			if (--rxLeft == 0) {
+				cursor = (rxAt < DISPLAY_CELLS) ? rxAt : DISPLAY_CELLS;
+				rx = RX_OP;
+			}
+			break;
+		case RX_GOTO:
+			cursor = (c < DISPLAY_CELLS) ? c : DISPLAY_CELLS;
+			rx = RX_OP;
+			break;
+		case RX_SLOT:
+			rxAt = c & (GLYPH_SLOTS - 1);
+			rxLeft = 0;
+			rx = RX_ROWS;
+			break;
+		case RX_ROWS:
+			glyphs[rxAt][rxLeft] = c;
+			if (++rxLeft == 8) {
+				glyphDirty[rxAt] = 1;
+				rx = RX_OP;
+			}
+			break;
+		case RX_SHIFT:
+			shift = (c < DISPLAY_LINE) ? c : 0;
+			rx = RX_OP;
+			break;
+		default:
+			break;					// unknown frame, up to SS going high
+	}
+	SPDR = lost ? DISPLAY_IN_LOST : input;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Restarts the decoder when SS goes high, which ends a frame
+ISR(PCINT1_vect)
+{
+	if (GET_BIT(PINB, SPI_SS)) { rx = RX_OP; }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads one channel of the free-running ADC; unlike
+//				  ADC_Read() it leaves interrupts on, so no SPI byte is missed
+//Parameter: ADC channel 0..7
+//Returns: The 10-bit result
+unsigned short readAdc(unsigned char ch)
+{
+	unsigned char i;
+
+	ADMUX = ch;
+	for (i = 0; i < ADC_SETTLE_NOPS; ++i) { asm("nop"); }
+	return ADC;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Scans the joystick and keypad
+//Parameter: None
+//Returns: Their DISPLAY_IN() state
+unsigned char readInput()
+{
+	unsigned short lr = readAdc(JOY_LR_CHANNEL);
+	unsigned short ud = readAdc(JOY_UD_CHANNEL);
+	unsigned char key = GetKeypadKey();
+	unsigned char dir, k;
+
+	// same thresholds as main.c
+	if (lr < 150) { dir = DIR_UP; }
+	else if (lr > 850) { dir = DIR_DOWN; }
+	else if (ud < 150) { dir = DIR_LEFT; }
+	else if (ud > 800) { dir = DIR_RIGHT; }
+	else { dir = DIR_NONE; }
+
+	for (k = 0; key && pgm_read_byte(&displayKeys[k]) != key; ++k) {}
+	return DISPLAY_IN(dir, key ? k + 1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Moves the LCD's address counter to a cell
+//Parameter: The cell, 0..79
+//Returns: None
+void gotoCell(unsigned char i)
+{
+	LCD_WriteCommand(0x80 | ((i < DISPLAY_LINE) ? i : 0x40 + i - DISPLAY_LINE));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Brings the LCD up to date with the copy of the screen
+//Parameter: None
+//Returns: None
+void drawCells()
+{
+	static unsigned char lcdAt;		// cell the LCD's address counter is on, 0xFF for none
+	static unsigned char lcdGen;	// clearGen the LCD was last cleared for
+	unsigned char rows[8];
+	unsigned char i, j, c, g, todo, to, gen;
+
+	for (i = 0; i < GLYPH_SLOTS; ++i) {
+		if (!glyphDirty[i]) { continue; }
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			glyphDirty[i] = 0;
+			for (j = 0; j < 8; ++j) { rows[j] = glyphs[i][j]; }
+		}
+		LCD_DefineChar(i, rows);
+		lcdAt = 0xFF;
+	}
+	gen = clearGen;
+	if (gen != lcdGen) {
+		LCD_ClearScreen();
+		lcdGen = gen;
+		lcdAt = 0;
+		// what was drawn since the clear is written again; older cells are
+		// blanked for good, so a wrapped generation cannot bring them back
+		for (i = 0; i < DISPLAY_CELLS; ++i) {
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+				if (cellGen[i] != gen) {
+					if (cellGen[i] != clearGen) {
+						cells[i] = ' ';
+						cellGen[i] = gen;
+					}
+				}
+				else if (cells[i] != ' ') { dirty[i] = 1; }
+			}
+		}
+	}
+	for (i = 0; i < DISPLAY_CELLS; ++i) {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			todo = dirty[i];
+			g = cellGen[i];
+			c = cells[i];
+			if (g == lcdGen) { dirty[i] = 0; }	// else left for after its clear
+		}
+		if (!todo || g != lcdGen) { continue; }
+		if (i != lcdAt) { gotoCell(i); }
+		LCD_WriteData(c);
+		lcdAt = (i + 1 < DISPLAY_CELLS) ? i + 1 : 0;	// DDRAM goes on from 0x27 to 0x40
+	}
+	LCD_Shift(shift);					// leaves the address counter alone
+	to = cursor;
+	if (to != lcdAt) {
+		if (to < DISPLAY_CELLS) { gotoCell(to); }
+		lcdAt = to;
+	}
+}
+
+int main(void)
+{
+	unsigned char i;
+
+	KEYPAD_DDR = 0xF0; KEYPAD_PORT = 0xFF;	// keypad input
+	LCD_DATA_DDR = 0xFF;
+	LCD_CTRL_DDR |= (1 << LCD_RS) | (1 << LCD_E);
+	ADMUX = (1 << REFS0);
+	ADCSRA |= (1 << ADEN) | (1 << ADSC) | (1 << ADATE);
+
+	LCD_init();
+	for (i = 0; i < DISPLAY_CELLS; ++i) { cells[i] = ' '; }
+	input = readInput();
+
+	SPI_ServantInit();
+	SPDR = DISPLAY_IN_LOST;
+	PCMSK1 |= (1 << SPI_SS);		// PCINT8..15 are PB0..7
+	PCICR |= (1 << PCIE1);
+	sei();
+
+	for (;;) {
+		input = readInput();
+		drawCells();
+	}
+}
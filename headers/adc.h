@@ -0,0 +1,37 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Shared ADC access. The ADC free-runs (ADC_init() in main.c), so a reading
+// is: select the channel, let a conversion on it finish, read the result.
+// Tasks run with interrupts enabled and the 1 ms tick samples as well, so
+// each reading is made atomic; it blocks interrupts for about 40 us.
+
+#ifndef ADC_H
+#define ADC_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+// ADC Setup Values
+#define ADC_SETTLE_NOPS 30			// wait after switching channels
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads one channel of the free-running ADC
+//Parameter: ADC channel 0..7
+//Returns: The 10-bit result
+unsigned short ADC_Read(unsigned char ch)
+{
+	unsigned char i;
+	unsigned short v;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ADMUX = ch;
+		for (i = 0; i < ADC_SETTLE_NOPS; ++i) { asm("nop"); }
+		v = ADC;
+	}
+	return v;
+}
+
+#endif //ADC_H
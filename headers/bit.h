@@ -1,4 +1,3 @@
-
 // Permission to copy is granted provided that this header remains intact. 
 // This software is provided with no warranties.
 
@@ -7,11 +6,19 @@
 #ifndef BIT_H
 #define BIT_H
 
+// Forced inline: with a constant pin number every call folds to a single
+// bit instruction instead of a call and a shift loop.
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+#define SET_BIT(p,i) ((p) |= (1 << (i)))
+#define CLR_BIT(p,i) ((p) &= ~(1 << (i)))
+#define GET_BIT(p,i) ((p) & (1 << (i)))
+
 ////////////////////////////////////////////////////////////////////////////////
 //Functionality - Sets bit on a PORTx
-//Parameter: Takes in a uChar for a PORTx, the pin number and the binary value 
+//Parameter: Takes in a uChar for a PORTx, the pin number and the binary value
 //Returns: The new value of the PORTx
-unsigned char SetBit(unsigned char pin, unsigned char number, unsigned char bin_value) 
+ALWAYS_INLINE unsigned char SetBit(unsigned char pin, unsigned char number, unsigned char bin_value)
 {
 	return (bin_value ? pin | (0x01 << number) : pin & ~(0x01 << number));
 }
@@ -20,9 +27,9 @@ unsigned char SetBit(unsigned char pin, unsigned char number, unsigned char bin_
 //Functionality - Gets bit from a PINx
 //Parameter: Takes in a uChar for a PINx and the pin number
 //Returns: The value of the PINx
-unsigned char GetBit(unsigned char port, unsigned char number) 
+ALWAYS_INLINE unsigned char GetBit(unsigned char port, unsigned char number)
 {
 	return ( port & (0x01 << number) );
 }
 
-#endif //BIT_H
\ No newline at end of file
+#endif //BIT_H
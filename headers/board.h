@@ -0,0 +1,101 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Board configuration: every port, pin and channel the firmware touches.
+// All values are compile-time constants so the drivers reduce to single
+// sbi/cbi/in/out instructions. Override any of them before the first
+// include (or with -D) for a different board.
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <avr/io.h>
+
+#ifndef F_CPU
+#define F_CPU 8000000UL				// the uC operates at 8MHz
+#endif
+
+// Keypad: rows on Px0-3 (inputs with pull-ups), columns on Px4-7 (outputs)
+#ifndef KEYPAD_PORT
+#define KEYPAD_PORT PORTB
+#define KEYPAD_PIN  PINB
+#define KEYPAD_DDR  DDRB
+#endif
+
+// LCD: 8-bit data bus plus RS and E on the control port
+#ifndef LCD_DATA_PORT
+#define LCD_DATA_PORT PORTC
+#define LCD_DATA_DDR  DDRC
+#endif
+#ifndef LCD_CTRL_PORT
+#define LCD_CTRL_PORT PORTD
+#define LCD_CTRL_DDR  DDRD
+#define LCD_RS PD6					// pin 4 of the LCD
+#define LCD_E  PD7					// pin 6 of the LCD
+#endif
+
+// 7-segment slot display behind a 74HC595 shift register
+#ifndef SHIFT_PORT
+#define SHIFT_PORT  PORTA
+#define SHIFT_DDR   DDRA
+#define SHIFT_SER   PA0				// serial data
+#define SHIFT_RCLK  PA1				// latch
+#define SHIFT_SRCLK PA2				// shift clock
+#define SHIFT_SRCLR PA3				// clear, active low
+#endif
+
+// Indicator lit once a zone has been watered
+#ifndef WATERED_PORT
+#define WATERED_PORT PORTD
+#define WATERED_BIT  PD0
+#endif
+
+// Valve outputs (bit numbers per zone are in zones.h)
+#ifndef VALVE_PORT_LO
+#define VALVE_PORT_LO PORTD
+#endif
+
+// Valve drive, timed and PWMed by Timer1 (valve.h); must be the OC1A pin
+#ifndef VALVE_DRIVE_PORT
+#define VALVE_DRIVE_PORT PORTD
+#define VALVE_DRIVE_DDR  DDRD
+#define VALVE_DRIVE_BIT  PD5
+#endif
+
+// Switched supply of the moisture probes and light sensors (sensor.h)
+#ifndef SENSOR_PWR_PORT
+#define SENSOR_PWR_PORT PORTD
+#define SENSOR_PWR_DDR  DDRD
+#define SENSOR_PWR_BIT  PD4
+#endif
+
+// Joystick ADC channels
+#ifndef JOY_LR_CHANNEL
+#define JOY_LR_CHANNEL 4
+#define JOY_UD_CHANNEL 5
+#endif
+
+// SPI: slave select and the fixed MOSI, MISO and SCK pins
+#ifndef SPI_PORT
+#define SPI_PORT PORTB
+#define SPI_DDR  DDRB
+#define SPI_SS   PB4
+#define SPI_MOSI PB5
+#define SPI_MISO PB6
+#define SPI_SCK  PB7
+#endif
+
+// 1 when the LCD, keypad and joystick sit on a display servant on SPI
+// (display.h) instead of on this controller's ports
+#ifndef DISPLAY_REMOTE
+#define DISPLAY_REMOTE 0
+#endif
+
+// USART used for the history dump and other serial output
+#ifndef CONSOLE_USART
+#define CONSOLE_USART 1
+#endif
+
+#endif //BOARD_H
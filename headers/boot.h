@@ -0,0 +1,97 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Staged boot. The scheduler timer is started first thing in main(), so the
+// watering clock runs from reset. The LCD's 100 ms power-on wait and init
+// commands are stepped from the 1 ms tick (Boot_LcdTick(), called by main's
+// tick hook) instead of blocking main(). That leaves the ADC, the profile
+// cache and the first sensor sample free to finish within a few ms of reset.
+// The UI task draws nothing until bootLcdReady is set.
+//
+// Each phase is timestamped in 0.1 ms units since the timer started.
+// Console: "B,<phase>,<time>" per phase, phases numbered as BOOT_ below.
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "board.h"
+#include "scheduler.h"
+#include "usart.h"
+#include "fmt.h"
+#include "io.h"
+
+enum {
+	BOOT_TIMER,						// scheduler timer running
+	BOOT_ADC,						// ADC converting
+	BOOT_PROFILES,					// EEPROM profile cache and sensor curves loaded
+	BOOT_ZONES,						// zones bound (and restored after a warm restart)
+	BOOT_SAMPLE,					// first sensor sample taken
+	BOOT_HISTORY,					// history ring recovered
+	BOOT_TASKS,						// tasks registered
+	BOOT_LCD,						// display initialised
+	BOOT_UI,						// first screen drawn
+	BOOT_PHASES
+};
+
+unsigned short bootStamp[BOOT_PHASES];
+unsigned char bootLcdReady;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records the time a boot phase finished
+//Parameter: BOOT_ phase
+//Returns: None
+void Boot_Stamp(unsigned char phase)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		bootStamp[phase] = tasksMs * 10 + (unsigned char)(TCNT1 * 10 / (SCHED_TICK_TOP + 1));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Steps the LCD init sequence; call every 1 ms until
+//				  bootLcdReady is set
+//Parameter: None
+//Returns: None
+void Boot_LcdTick()
+{
+	if (LCD_InitStep()) {
+		bootLcdReady = 1;
+		Boot_Stamp(BOOT_LCD);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Skips the LCD sequence when the display is still set up
+//Parameter: 1 after a warm restart, else 0
+//Returns: None
+void Boot_StartLcd(unsigned char warm)
+{
+	if (warm) { bootLcdReady = 1; }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends every phase timestamp on the console USART
+//Parameter: None
+//Returns: None
+void Boot_Report()
+{
+	unsigned char buf[FMT_U16_MAX + 1];
+	unsigned char i, j, n;
+
+	for (i = 0; i < BOOT_PHASES; ++i) {
+		USART_Send('B', CONSOLE_USART);
+		USART_Send(',', CONSOLE_USART);
+		USART_Send('0' + i, CONSOLE_USART);
+		USART_Send(',', CONSOLE_USART);
+		n = Fmt_U16(buf, bootStamp[i], 1, '0', 0);
+		for (j = 0; j < n; ++j) { USART_Send(buf[j], CONSOLE_USART); }
+		USART_Send('\r', CONSOLE_USART);
+		USART_Send('\n', CONSOLE_USART);
+	}
+}
+
+#endif //BOOT_H
@@ -0,0 +1,184 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Sensor calibration curves. Each sensor kind (every zone's moisture probe
+// shares one curve, every light sensor the other) has up to CAL_POINTS
+// reference points captured from the menus: a raw reading and the value it
+// stands for, in calibrated units of 0.1% (0..CAL_FULL). Readings between
+// points are interpolated linearly, readings outside them clamp to the end
+// points. Profile thresholds are kept in calibrated units.
+//
+// The points are kept in EEPROM and cached like the profiles. From them a
+// table is built with every segment's start, value and Q16 slope, plus an
+// index from the top bits of a raw reading to its segment, so Cal_Apply()
+// costs one table index and one multiply. Without a stored curve the map is
+// raw 0..1000 to 0..1000 one to one, so thresholds saved as raw readings
+// keep their meaning.
+//
+// EEPROM layout
+//   addr CAL_EE_BASE + c * sizeof(CalCurve), c = CAL_MS or CAL_SUN
+
+#ifndef CALIB_H
+#define CALIB_H
+
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "fixmap.h"
+#include "trace.h"
+
+// Calibration Setup Values
+#define CAL_SENSORS 2
+#define CAL_MS      0
+#define CAL_SUN     1
+#define CAL_POINTS  6				// reference points per curve
+#define CAL_FULL    1000			// calibrated full scale, 0.1% units
+#define CAL_EE_BASE 40				// after the profile slots, before the history
+#define CAL_BUCKET_SHIFT 4			// raw >> 4: 64 index entries for 10 bits
+#define CAL_BUCKETS (1024 >> CAL_BUCKET_SHIFT)
+
+// Calibrated value as a percentage for display
+#define CAL_PERCENT(x) MAP_RANGE(x, 0, CAL_FULL, 0, 100)
+
+typedef struct CalCurve {
+	unsigned char n;				// points in use, 2..CAL_POINTS
+	unsigned short raw[CAL_POINTS];	// increasing
+	unsigned short val[CAL_POINTS];	// calibrated value at each raw point
+} CalCurve;
+
+// Segment 0 runs flat up to the first point and segment n flat from the last
+typedef struct CalTable {
+	unsigned char bucket[CAL_BUCKETS];	// first segment of each raw >> CAL_BUCKET_SHIFT
+	unsigned short segRaw[CAL_POINTS + 2];	// start of each segment, then 0xFFFF
+	unsigned short segVal[CAL_POINTS + 1];
+	signed long segK[CAL_POINTS + 1];	// Q16 slope
+} CalTable;
+
+CalCurve calCurve[CAL_SENSORS];		// cache of the EEPROM curves
+CalTable calTable[CAL_SENSORS];		// read by the tick, see Cal_Build()
+
+#define CAL_EE_ADDR(c) ((unsigned char*)(CAL_EE_BASE + (c) * sizeof(CalCurve)))
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Checks that a curve is usable: 2 or more increasing points
+//Parameter: The curve
+//Returns: 1 if valid else 0
+unsigned char Cal_IsValid(const CalCurve* k)
+{
+	unsigned char i;
+	if (k->n < 2 || k->n > CAL_POINTS) { return 0; }
+	for (i = 0; i < k->n; ++i) {
+		if (k->raw[i] > 1023 || k->val[i] > CAL_FULL) { return 0; }
+		if (i && k->raw[i] <= k->raw[i - 1]) { return 0; }
+	}
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Rebuilds the interpolation table of one curve; the table is
+//				  built aside and copied in atomically, as the tick reads it
+//Parameter: CAL_MS or CAL_SUN
+//Returns: None
+void Cal_Build(unsigned char c)
+{
+	const CalCurve* k = &calCurve[c];
+	CalTable t;
+	unsigned char i, s;
+
+	t.segRaw[0] = 0;
+	t.segVal[0] = k->val[0];
+	t.segK[0] = 0;
+	for (i = 0; i < k->n; ++i) {
+		t.segRaw[i + 1] = k->raw[i];
+		t.segVal[i + 1] = k->val[i];
+		t.segK[i + 1] = (i + 1 < k->n)
+			? (signed long)(signed short)(k->val[i + 1] - k->val[i]) * (1L << MAP_SHIFT) / (k->raw[i + 1] - k->raw[i])
+			: 0;
+	}
+	t.segRaw[k->n + 1] = 0xFFFF;
+	for (i = 0, s = 0; i < CAL_BUCKETS; ++i) {
+		while (t.segRaw[s + 1] <= ((unsigned short)i << CAL_BUCKET_SHIFT)) { ++s; }
+		t.bucket[i] = s;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { calTable[c] = t; }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Loads both curves from EEPROM, falling back to the one to
+//				  one map where none was stored, and builds their tables
+//Parameter: None
+//Returns: None
+void Cal_Load()
+{
+	unsigned char c;
+	eeprom_read_block(calCurve, CAL_EE_ADDR(0), sizeof(calCurve));
+	for (c = 0; c < CAL_SENSORS; ++c) {
+		if (!Cal_IsValid(&calCurve[c])) {
+			calCurve[c].n = 2;
+			calCurve[c].raw[0] = 0;
+			calCurve[c].val[0] = 0;
+			calCurve[c].raw[1] = CAL_FULL;
+			calCurve[c].val[1] = CAL_FULL;
+		}
+		Cal_Build(c);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sorts captured points by raw reading and stores them as the
+//				  new curve, programming only the EEPROM bytes that differ
+//				  (the cache may hold the default curve, not the EEPROM)
+//Parameter: CAL_MS or CAL_SUN and the points, in any order
+//Returns: 1 if stored, 0 if the points do not make a valid curve
+unsigned char Cal_Put(unsigned char c, const CalCurve* in)
+{
+	CalCurve k = *in;
+	const unsigned char* src = (const unsigned char*)&k;
+	unsigned char* ee = CAL_EE_ADDR(c);
+	unsigned short r, v;
+	unsigned char i, j;
+
+	for (i = 1; i < k.n && i < CAL_POINTS; ++i) {
+		r = k.raw[i];
+		v = k.val[i];
+		for (j = i; j && k.raw[j - 1] > r; --j) {
+			k.raw[j] = k.raw[j - 1];
+			k.val[j] = k.val[j - 1];
+		}
+		k.raw[j] = r;
+		k.val[j] = v;
+	}
+	if (!Cal_IsValid(&k)) { return 0; }
+	for (i = k.n; i < CAL_POINTS; ++i) {
+		k.raw[i] = 0;
+		k.val[i] = 0;
+	}
+
+	for (i = 0; i < sizeof(CalCurve); ++i) {
+		if (eeprom_read_byte(ee + i) != src[i]) {
+			eeprom_write_byte(ee + i, src[i]);
+			Trace(TRACE_EEPROM, TRACE_EE_CALIB);
+		}
+	}
+	calCurve[c] = k;
+	Cal_Build(c);
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Converts a raw reading to calibrated units
+//Parameter: CAL_MS or CAL_SUN and the raw 10-bit reading
+//Returns: The calibrated value, 0..CAL_FULL
+unsigned short Cal_Apply(unsigned char c, unsigned short raw)
+{
+	const CalTable* t = &calTable[c];
+	unsigned char s;
+
+	if (raw > 1023) { raw = 1023; }
+	s = t->bucket[raw >> CAL_BUCKET_SHIFT];
+	while (raw >= t->segRaw[s + 1]) { ++s; }
+	return t->segVal[s] + (signed short)(((signed long)(raw - t->segRaw[s]) * t->segK[s] + (signed long)MAP_HALF) >> MAP_SHIFT);
+}
+
+#endif //CALIB_H
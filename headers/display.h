@@ -0,0 +1,230 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Display co-processor. With DISPLAY_REMOTE set (board.h) the LCD, keypad
+// and joystick sit on a second ATmega running the display servant
+// (display/display.c), and this controller is its SPI master.
+//
+// The LCD_ calls the UI makes then land in displayCells, a copy of the LCD's
+// DDRAM (two lines of 40 characters, see viewport.h) in SRAM, instead of on
+// the LCD bus. Display_Flush(), at the end of
+// each UI tick, compares it with displaySent (what the servant shows) and
+// sends only the runs of cells that changed. A four-digit field costs about
+// ten SPI bytes, some 0.3 ms, where the LCD takes 6 ms of command and data
+// waits; the servant writes its LCD at the LCD's pace.
+//
+// Frames, each sent with SS held low (SS going high ends a frame):
+//   DISPLAY_OP_CLEAR                          blank every cell, cursor to cell 0, no shift
+//   DISPLAY_OP_CELLS <at> <n> <n characters>  cells at..at+n-1 (0..79, row 2 from 40), cursor after
+//   DISPLAY_OP_GOTO <at>                      cursor to cell at
+//   DISPLAY_OP_GLYPH <slot> <8 rows>          CGRAM pattern of a slot (glyph.h)
+//   DISPLAY_OP_SHIFT <n>                      display shift, cell n of each row in column 1
+//   DISPLAY_OP_NOP                            nothing, clocks in the input state
+// Each byte the servant receives, it loads its input state to be clocked out
+// with the next one: DISPLAY_IN(dir, key), dir numbered as DIR_ in menu.h and
+// key the 1-based place in displayKeys (0 for none). Until it is sent a
+// clear after a reset it answers DISPLAY_IN_LOST, so the master repaints;
+// a missing servant reads the same.
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "board.h"
+#include "bit.h"
+#include "spi.h"
+#include "io.h"
+#include "glyph.h"
+
+// Display Setup Values
+#define DISPLAY_LINE 40				// cells per row, as DDRAM
+#define DISPLAY_CELLS (2 * DISPLAY_LINE)
+#define DISPLAY_RUN_GAP 3			// unchanged cells that end a run, the cost of a frame header
+#define DISPLAY_GAP_NOPS 20			// after each byte, for the servant's ISR to reload SPDR
+
+#define DISPLAY_OP_NOP   0x00
+#define DISPLAY_OP_CLEAR 0x01
+#define DISPLAY_OP_CELLS 0x02
+#define DISPLAY_OP_GOTO  0x03
+#define DISPLAY_OP_GLYPH 0x04
+#define DISPLAY_OP_SHIFT 0x05
+
+#define DISPLAY_IN(dir, key) (((dir) << 5) | (key))
+#define DISPLAY_IN_LOST 0xFF
+
+// Keypad keys in the order of GetKeypadKey()'s scan
+const char displayKeys[] PROGMEM = "123A456B789C*0#D";
+
+#if DISPLAY_REMOTE
+
+unsigned char displayCells[DISPLAY_CELLS];	// what the UI drew
+unsigned char displaySent[DISPLAY_CELLS];	// what the servant shows
+unsigned char displayAt;					// UI cursor, a cell
+unsigned char displaySentAt;				// servant cursor
+unsigned char displayShift;					// UI display shift
+unsigned char displaySentShift;				// servant display shift
+unsigned char displayIn = DISPLAY_IN_LOST;	// last input state clocked in
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends one byte of a frame and keeps the servant's answer
+//Parameter: The byte
+//Returns: None
+void Display_Byte(unsigned char c)
+{
+	unsigned char i;
+
+	displayIn = SPI_MasterTransfer(c);
+	for (i = 0; i < DISPLAY_GAP_NOPS; ++i) { asm("nop"); }
+}
+
+// LCD calls of io.c, on the copy in SRAM
+
+void LCD_ClearScreen(void)
+{
+	unsigned char i;
+	for (i = 0; i < DISPLAY_CELLS; ++i) { displayCells[i] = ' '; }
+	displayAt = 0;
+	displayShift = 0;
+}
+
+unsigned char LCD_InitStep(void)
+{
+	return 1;						// the servant sets up its own LCD
+}
+
+void LCD_Cursor(unsigned char column)
+{
+	if (column < 17) { displayAt = column - 1; }
+	else { displayAt = (column > 32) ? DISPLAY_CELLS : DISPLAY_LINE + column - 17; }
+}
+
+void LCD_WriteData(unsigned char Data)
+{
+	if (displayAt < DISPLAY_CELLS) { displayCells[displayAt++] = Data; }
+}
+
+void LCD_Shift(unsigned char shift)
+{
+	displayShift = shift;			// sent in Display_Flush()
+}
+
+void LCD_DefineChar(unsigned char slot, const unsigned char* rows)
+{
+	unsigned char i;
+
+	// sent at once: the cells drawn with it go out later, in Display_Flush()
+	CLR_BIT(SPI_PORT, SPI_SS);
+	Display_Byte(DISPLAY_OP_GLYPH);
+	Display_Byte(slot);
+	for (i = 0; i < 8; ++i) { Display_Byte(rows[i]); }
+	SET_BIT(SPI_PORT, SPI_SS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Clocks in the servant's current input state
+//Parameter: None
+//Returns: None
+void Display_Poll()
+{
+	CLR_BIT(SPI_PORT, SPI_SS);
+	Display_Byte(DISPLAY_OP_NOP);
+	Display_Byte(DISPLAY_OP_NOP);		// answered with the state after the first
+	SET_BIT(SPI_PORT, SPI_SS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Gets the joystick direction from the last input state
+//Parameter: None
+//Returns: A DIR_ value
+unsigned char Display_Dir()
+{
+	unsigned char dir = displayIn >> 5;
+	// past DIR_RIGHT is a garbled answer, which would index past a
+	// Screen's next[]
+	if (displayIn == DISPLAY_IN_LOST || dir > 4) { return 0; }
+	return dir;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Gets the keypad key from the last input state
+//Parameter: None
+//Returns: The key as GetKeypadKey() returns it, '\0' if none
+unsigned char Display_Key()
+{
+	unsigned char k = displayIn & 0x1F;
+	if (displayIn == DISPLAY_IN_LOST || k == 0 || k > sizeof(displayKeys) - 1) { return '\0'; }
+	return pgm_read_byte(&displayKeys[k - 1]);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sets up the SPI master; nothing without DISPLAY_REMOTE
+//Parameter: None
+//Returns: None
+void Display_Init()
+{
+#if DISPLAY_REMOTE
+	SPI_MasterInit();
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends the cells and the shift that changed since the last
+//				  flush, all of them after the servant lost its screen;
+//				  nothing without DISPLAY_REMOTE
+//Parameter: None
+//Returns: None
+void Display_Flush()
+{
+#if DISPLAY_REMOTE
+	unsigned char at, end, gap;
+
+	if (displayIn == DISPLAY_IN_LOST) {
+		CLR_BIT(SPI_PORT, SPI_SS);
+		Display_Byte(DISPLAY_OP_CLEAR);
+		SET_BIT(SPI_PORT, SPI_SS);
+		for (at = 0; at < DISPLAY_CELLS; ++at) { displaySent[at] = ' '; }
+		displaySentAt = 0;
+		displaySentShift = 0;
+		Glyph_Reload();
+	}
+	for (at = 0; at < DISPLAY_CELLS; ++at) {
+		if (displayCells[at] == displaySent[at]) { continue; }
+		// a run goes on over gaps cheaper to resend than a new frame
+		for (end = at + 1, gap = 0; end < DISPLAY_CELLS && gap < DISPLAY_RUN_GAP; ++end) {
+			gap = (displayCells[end] == displaySent[end]) ? gap + 1 : 0;
+		}
+		end -= gap;
+		CLR_BIT(SPI_PORT, SPI_SS);
+		Display_Byte(DISPLAY_OP_CELLS);
+		Display_Byte(at);
+		Display_Byte(end - at);
+		for (; at < end; ++at) {
+			Display_Byte(displayCells[at]);
+			displaySent[at] = displayCells[at];
+		}
+		SET_BIT(SPI_PORT, SPI_SS);
+		displaySentAt = end;
+	}
+	if (displayAt != displaySentAt) {
+		CLR_BIT(SPI_PORT, SPI_SS);
+		Display_Byte(DISPLAY_OP_GOTO);
+		Display_Byte(displayAt);
+		SET_BIT(SPI_PORT, SPI_SS);
+		displaySentAt = displayAt;
+	}
+	if (displayShift != displaySentShift) {
+		CLR_BIT(SPI_PORT, SPI_SS);
+		Display_Byte(DISPLAY_OP_SHIFT);
+		Display_Byte(displayShift);
+		SET_BIT(SPI_PORT, SPI_SS);
+		displaySentShift = displayShift;
+	}
+#endif
+}
+
+#endif //DISPLAY_H
@@ -0,0 +1,28 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Integer range mapping. A linear map in -> out is done as one multiply by a
+// Q16 reciprocal slope and a shift, rounded to nearest; no floating point.
+// The ranges of MAP_RANGE() are compile-time constants, so the slope folds
+// into a literal and the map costs one 16x32 multiply.
+//
+// The Q16 slope is exact when (out span << 16) divides by the in span, as
+// 0-1024 -> 0-100 does; otherwise the result is off by at most x / 2^17 before
+// rounding. Output ranges must be increasing.
+
+#ifndef FIXMAP_H
+#define FIXMAP_H
+
+#define MAP_SHIFT 16
+#define MAP_HALF  (1UL << (MAP_SHIFT - 1))
+
+// Q16 slope (outMax - outMin) / (inMax - inMin), rounded
+#define MAP_K(inMin, inMax, outMin, outMax) \
+	(((((unsigned long)((outMax) - (outMin))) << MAP_SHIFT) + ((inMax) - (inMin)) / 2) / ((inMax) - (inMin)))
+
+#define MAP_RANGE(x, inMin, inMax, outMin, outMax) \
+	((outMin) + (unsigned short)((((unsigned long)((x) - (inMin))) * MAP_K(inMin, inMax, outMin, outMax) + MAP_HALF) >> MAP_SHIFT))
+
+#endif //FIXMAP_H
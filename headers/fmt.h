@@ -0,0 +1,44 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number formatting into a caller supplied buffer, so a field goes to the
+// display as one string. Digits are produced by reciprocal multiplication
+// (x * 0xCCCD >> 19 == x / 10 for every 16-bit x), no division routine.
+
+#ifndef FMT_H
+#define FMT_H
+
+#define FMT_U16_MAX 5				// digits in 65535
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Formats an unsigned value as decimal text
+//Parameter: Output buffer (width or FMT_U16_MAX, plus suffix, plus NUL),
+//			 the value, minimum digit count, pad character ('0' or ' ')
+//			 and an optional suffix such as "%" (0 for none)
+//Returns: Length of the string written, excluding the NUL
+unsigned char Fmt_U16(unsigned char* buf, unsigned short x, unsigned char width, unsigned char pad, const char* suffix)
+{
+	unsigned char digits[FMT_U16_MAX];
+	unsigned char n = 0;
+	unsigned char len = 0;
+	unsigned short q;
+
+	do {
+		q = (unsigned short)(((unsigned long)x * 0xCCCDUL) >> 19);
+		digits[n++] = '0' + (unsigned char)(x - ((q << 3) + (q << 1)));
+		x = q;
+	} while (x);
+
+	while (width > n) {
+		buf[len++] = pad;
+		--width;
+	}
+	while (n) { buf[len++] = digits[--n]; }
+	while (suffix && *suffix) { buf[len++] = *suffix++; }
+	buf[len] = '\0';
+	return len;
+}
+
+#endif //FMT_H
@@ -0,0 +1,178 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Custom glyphs: bar-graph segments and status icons in the LCD's eight CGRAM
+// slots. Loading a glyph is a command and eight data writes, about 10 ms, so
+// the slots are a cache: Glyph_Char() loads a glyph only when it is not
+// resident, into a free slot or else the least recently used one. A slot
+// used since the last screen clear is never taken, as its glyph may still be
+// showing. Slots are drawn as characters 8-15, never 0, so glyphs can be
+// part of a string.
+//
+// Bars are drawn with full blocks, one partial segment and blanks. A
+// GlyphBar remembers what it shows and rewrites only the cells between the
+// old and the new end; a bar creeping by a column is one cursor move and one
+// data write.
+//
+// Glyph_Char() may write CGRAM, so get every character before placing the
+// cursor for text.
+
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <avr/pgmspace.h>
+#include "io.h"
+
+// Glyph Setup Values
+#define GLYPH_SLOTS 8
+#define GLYPH_CHAR0 8				// character of slot 0
+#define GLYPH_BLOCK 0xFF			// full block in the LCD's ROM
+#define GLYPH_BAR_STEPS 5			// columns per cell
+
+enum {
+	GLYPH_BAR1,						// 1 to 4 columns of a bar cell, from the left
+	GLYPH_BAR2,
+	GLYPH_BAR3,
+	GLYPH_BAR4,
+	GLYPH_DROP,						// moisture
+	GLYPH_SUN,						// sunlight
+	GLYPH_COUNT
+};
+
+const unsigned char glyphRows[GLYPH_COUNT][8] PROGMEM = {
+	[GLYPH_BAR1] = { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },
+	[GLYPH_BAR2] = { 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18 },
+	[GLYPH_BAR3] = { 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C },
+	[GLYPH_BAR4] = { 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E },
+	[GLYPH_DROP] = { 0x04, 0x04, 0x0A, 0x0A, 0x11, 0x11, 0x0E, 0x00 },
+	[GLYPH_SUN]  = { 0x00, 0x15, 0x0E, 0x1B, 0x0E, 0x15, 0x00, 0x00 },
+};
+
+// ROM characters drawn instead when every slot is showing
+const unsigned char glyphFallback[GLYPH_COUNT] PROGMEM = { '|', '|', '|', '|', 'M', 'S' };
+
+unsigned char glyphSlotOf[GLYPH_COUNT];	// slot + 1 holding the glyph, 0 if none
+unsigned char glyphInSlot[GLYPH_SLOTS];	// glyph + 1 in the slot, 0 if free
+unsigned char glyphUsed[GLYPH_SLOTS];	// glyphClock when last drawn
+unsigned char glyphClock;
+unsigned char glyphShown;				// slots drawn since the screen was cleared
+unsigned char glyphScreen;				// counts screen clears
+unsigned short glyphLoads;				// CGRAM uploads since reset
+
+typedef struct GlyphBar {
+	unsigned char screen;			// glyphScreen when drawn
+	unsigned char shown;			// columns drawn
+} GlyphBar;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes a glyph's pattern into a CGRAM slot
+//Parameter: The slot and the glyph
+//Returns: None
+void Glyph_Load(unsigned char s, unsigned char g)
+{
+	unsigned char rows[8];
+	unsigned char i;
+
+	for (i = 0; i < 8; ++i) { rows[i] = pgm_read_byte(&glyphRows[g][i]); }
+	LCD_DefineChar(s, rows);
+	++glyphLoads;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Gets the character that draws a glyph, loading it if needed
+//Parameter: GLYPH_ glyph
+//Returns: The character, GLYPH_CHAR0 + slot
+unsigned char Glyph_Char(unsigned char g)
+{
+	unsigned char s = glyphSlotOf[g];
+	unsigned char i;
+
+	if (s) { --s; }
+	else {
+		s = GLYPH_SLOTS;
+		for (i = 0; i < GLYPH_SLOTS; ++i) {
+			if (glyphShown & (1 << i)) { continue; }
+			if (!glyphInSlot[i]) {
+				s = i;
+				break;
+			}
+			if (s == GLYPH_SLOTS || (unsigned char)(glyphClock - glyphUsed[i]) > (unsigned char)(glyphClock - glyphUsed[s])) { s = i; }
+		}
+		if (s == GLYPH_SLOTS) { return pgm_read_byte(&glyphFallback[g]); }
+		if (glyphInSlot[s]) { glyphSlotOf[glyphInSlot[s] - 1] = 0; }
+		glyphInSlot[s] = g + 1;
+		glyphSlotOf[g] = s + 1;
+		Glyph_Load(s, g);
+	}
+	glyphUsed[s] = ++glyphClock;
+	glyphShown |= 1 << s;
+	return GLYPH_CHAR0 + s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Frees the slots for reuse; call when the screen was cleared
+//Parameter: None
+//Returns: None
+void Glyph_NewScreen()
+{
+	glyphShown = 0;
+	++glyphScreen;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Loads every resident glyph again, for a display that lost
+//				  its CGRAM
+//Parameter: None
+//Returns: None
+void Glyph_Reload()
+{
+	unsigned char s;
+	for (s = 0; s < GLYPH_SLOTS; ++s) {
+		if (glyphInSlot[s]) { Glyph_Load(s, glyphInSlot[s] - 1); }
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Draws one glyph
+//Parameter: The column (1-32) and the GLYPH_ glyph
+//Returns: None
+void Glyph_Put(unsigned char column, unsigned char g)
+{
+	unsigned char c = Glyph_Char(g);
+	LCD_Cursor(column);
+	LCD_WriteData(c);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Draws a horizontal bar, rewriting only the cells that changed
+//				  since it was last drawn on this screen
+//Parameter: The bar, its first column (1-32), its width in cells (up to 16,
+//			 within one row) and its length in columns (GLYPH_BAR_STEPS per cell)
+//Returns: None
+void Glyph_Bar(GlyphBar* b, unsigned char column, unsigned char cells, unsigned char cols)
+{
+	unsigned char buf[17];
+	unsigned char first = 0, last = cells - 1, i, n = 0;
+
+	if (cols > cells * GLYPH_BAR_STEPS) { cols = cells * GLYPH_BAR_STEPS; }
+	if (b->screen == glyphScreen) {
+		if (b->shown == cols) { return; }
+		// cells holding either end
+		first = ((b->shown < cols) ? b->shown : cols) / GLYPH_BAR_STEPS;
+		i = ((b->shown > cols) ? b->shown : cols) - 1;
+		if (i / GLYPH_BAR_STEPS < last) { last = i / GLYPH_BAR_STEPS; }
+	}
+	for (i = first; i <= last; ++i) {
+		if (cols >= (i + 1) * GLYPH_BAR_STEPS) { buf[n++] = GLYPH_BLOCK; }
+		else if (cols > i * GLYPH_BAR_STEPS) { buf[n++] = Glyph_Char(GLYPH_BAR1 + cols - i * GLYPH_BAR_STEPS - 1); }
+		else { buf[n++] = ' '; }
+	}
+	buf[n] = '\0';
+	LCD_DisplayString(column + first, buf);
+	b->screen = glyphScreen;
+	b->shown = cols;
+}
+
+#endif //GLYPH_H
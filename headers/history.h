@@ -0,0 +1,401 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Sensor history. Periodic moisture/sunlight samples and watering events are
+// appended to fixed size pages in an SRAM ring. Finished pages are copied to
+// an EEPROM ring one byte per service call, so spilling never blocks a task.
+//
+// Samples are stored as 8-bit values (raw >> HISTORY_SHIFT) and delta coded
+// against the previous sample:
+//   00mmmsss                    sample, both deltas in -4..3 (1 byte)
+//   0x40 <zz dMS> <zz dSUN>     sample, zigzag varint deltas
+//   10eeeeee <arg>              event e with a varint argument
+//   0xC0 <seq lo> <seq hi> <MS> <SUN>   page key, absolute base values
+//   0xFF                        end of page
+// The EEPROM ring is 124 pages of about 26 bytes of records each. At one
+// sample every 5 min it holds some 11 days of one-byte samples, and less
+// with wide deltas or events.
+//
+// Records carry no time. The sample number of a dump only counts samples
+// from the oldest one stored; no samples are taken while the unit is off,
+// and each boot (HIST_EV_BOOT) starts the sample period over, so it is not a
+// clock across boots.
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <avr/eeprom.h>
+#include "board.h"
+#include "usart.h"
+#include "fmt.h"
+#include "trace.h"
+
+// History Setup Values
+#define HISTORY_PAGE      32
+#define HISTORY_RAM_PAGES 4
+#define HISTORY_EE_BASE   128
+#define HISTORY_EE_PAGES  ((E2END + 1 - HISTORY_EE_BASE) / HISTORY_PAGE)
+#define HISTORY_PERIOD    3000		// 100 ms ticks between samples (5 min)
+#define HISTORY_SHIFT     2			// 10-bit ADC reading stored as 8 bits
+#define HISTORY_DUMP_LINES 2		// CSV lines per History_DumpStep(), under 50 ms at 9600 baud
+
+#define HIST_KEY   0xC0
+#define HIST_END   0xFF
+#define HIST_WIDE  0x40
+#define HIST_EVENT 0x80
+#define HIST_KEY_LEN 5
+
+// Event codes (0 is reserved for samples)
+#define HIST_EV_WATER 1				// arg: mask of zones that started watering
+#define HIST_EV_BOOT  2
+#define HIST_EV_WATER_END   3		// arg: ms of water, moisture target reached or pulse ended
+#define HIST_EV_WATER_LIMIT 4		// arg: ms of water, stopped at the limit short of the target
+
+typedef struct HistoryEntry {
+	unsigned short sample;			// samples seen since the start of the walk, not a time
+	unsigned char event;			// 0 for a sample, else an HIST_EV_ code
+	unsigned short arg;
+	unsigned char ms;				// moisture, raw >> HISTORY_SHIFT
+	unsigned char sun;				// sunlight, raw >> HISTORY_SHIFT
+} HistoryEntry;
+
+typedef struct HistoryIter {
+	unsigned short seq;
+	unsigned char pos;
+	unsigned char ms;
+	unsigned char sun;
+	unsigned short sample;
+} HistoryIter;
+
+unsigned char histRam[HISTORY_RAM_PAGES][HISTORY_PAGE];
+unsigned short histSeq;				// page being filled
+unsigned char histPos;				// write offset in it, 0 = no page open
+unsigned short histFirstSeq;		// oldest page still stored
+unsigned short histSpillSeq;		// next page to copy to EEPROM
+unsigned char histSpillPos;
+unsigned char histMS;
+unsigned char histSun;
+unsigned short histTicks;
+
+#define HISTORY_EE_ADDR(seq, pos) ((unsigned char*)(HISTORY_EE_BASE + ((seq) % HISTORY_EE_PAGES) * HISTORY_PAGE + (pos)))
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads one byte of a page from SRAM or, once spilled, EEPROM
+//Parameter: Page sequence number and offset within the page
+//Returns: The stored byte
+unsigned char History_PageByte(unsigned short seq, unsigned char pos)
+{
+	if (seq >= histSpillSeq) {
+		return histRam[seq % HISTORY_RAM_PAGES][pos];
+	}
+	return eeprom_read_byte(HISTORY_EE_ADDR(seq, pos));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Copies the next byte of the oldest finished page to EEPROM
+//				  The key byte is invalidated first and written last, so a page
+//				  torn by a reset is skipped at boot
+//Parameter: None
+//Returns: None
+void History_Service()
+{
+	unsigned char* ee;
+	if (histSpillSeq == histSeq || !eeprom_is_ready()) { return; }
+
+	ee = HISTORY_EE_ADDR(histSpillSeq, histSpillPos);
+	if (histSpillPos == 0) {
+		// the page that used to live in this slot is gone from here on
+		if (histSpillSeq >= HISTORY_EE_PAGES && histFirstSeq <= histSpillSeq - HISTORY_EE_PAGES) {
+			histFirstSeq = histSpillSeq - HISTORY_EE_PAGES + 1;
+		}
+		eeprom_update_byte(ee, HIST_END);
+		Trace(TRACE_EEPROM, TRACE_EE_HISTORY);
+		++histSpillPos;
+	}
+	else if (histSpillPos < HISTORY_PAGE) {
+		eeprom_update_byte(ee, histRam[histSpillSeq % HISTORY_RAM_PAGES][histSpillPos]);
+		Trace(TRACE_EEPROM, TRACE_EE_HISTORY);
+		++histSpillPos;
+	}
+	else {
+		eeprom_write_byte(HISTORY_EE_ADDR(histSpillSeq, 0), HIST_KEY);
+		Trace(TRACE_EEPROM, TRACE_EE_HISTORY);
+		histSpillPos = 0;
+		++histSpillSeq;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Closes the current page and opens the next one
+//Parameter: None
+//Returns: None
+void History_NewPage()
+{
+	unsigned char* page;
+	unsigned char i;
+
+	if (histPos != 0) { ++histSeq; }
+	// SRAM ring full: the EEPROM has fallen behind, finish the oldest page now
+	while (histSeq - histSpillSeq >= HISTORY_RAM_PAGES) {
+		History_Service();
+	}
+
+	page = histRam[histSeq % HISTORY_RAM_PAGES];
+	for (i = 0; i < HISTORY_PAGE; ++i) { page[i] = HIST_END; }
+	page[0] = HIST_KEY;
+	page[1] = (unsigned char)histSeq;
+	page[2] = (unsigned char)(histSeq >> 8);
+	page[3] = histMS;
+	page[4] = histSun;
+	histPos = HIST_KEY_LEN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Appends an encoded record, starting a new page if it won't fit
+//Parameter: The record bytes and their count
+//Returns: None
+void History_Put(const unsigned char* rec, unsigned char n)
+{
+	unsigned char i;
+	if (histPos == 0 || histPos + n > HISTORY_PAGE) { History_NewPage(); }
+	for (i = 0; i < n; ++i) {
+		histRam[histSeq % HISTORY_RAM_PAGES][histPos++] = rec[i];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Encodes a value as a little endian base-128 varint
+//Parameter: Output buffer and the value
+//Returns: Number of bytes written
+unsigned char History_PutVar(unsigned char* out, unsigned short v)
+{
+	unsigned char n = 0;
+	while (v > 0x7F) {
+		out[n++] = (unsigned char)v | 0x80;
+		v >>= 7;
+	}
+	out[n++] = (unsigned char)v;
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records a sample
+//Parameter: Raw 10-bit moisture and sunlight readings
+//Returns: None
+void History_Sample(unsigned short msRaw, unsigned short sunRaw)
+{
+	unsigned char rec[7];
+	unsigned char n;
+	unsigned char ms = msRaw >> HISTORY_SHIFT;
+	unsigned char sun = sunRaw >> HISTORY_SHIFT;
+	signed short dm = (signed short)ms - histMS;
+	signed short ds = (signed short)sun - histSun;
+
+	if (dm >= -4 && dm <= 3 && ds >= -4 && ds <= 3) {
+		rec[0] = ((dm + 4) << 3) | (ds + 4);
+		n = 1;
+	}
+	else {
+		rec[0] = HIST_WIDE;
+		n = 1;
+		n += History_PutVar(rec + n, (unsigned short)((dm << 1) ^ (dm >> 15)));
+		n += History_PutVar(rec + n, (unsigned short)((ds << 1) ^ (ds >> 15)));
+	}
+	History_Put(rec, n);
+	histMS = ms;
+	histSun = sun;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records an event
+//Parameter: An HIST_EV_ code and its argument
+//Returns: None
+void History_Event(unsigned char event, unsigned short arg)
+{
+	unsigned char rec[4];
+	rec[0] = HIST_EVENT | (event & 0x3F);
+	History_Put(rec, 1 + History_PutVar(rec + 1, arg));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Takes a sample every HISTORY_PERIOD calls and services the spill
+//Parameter: Raw 10-bit moisture and sunlight readings; call every 100 ms
+//Returns: None
+void History_Tick(unsigned short msRaw, unsigned short sunRaw)
+{
+	if (++histTicks >= HISTORY_PERIOD) {
+		histTicks = 0;
+		History_Sample(msRaw, sunRaw);
+	}
+	History_Service();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Finds the stored pages in EEPROM and continues after the newest
+//Parameter: None
+//Returns: None
+void History_Init()
+{
+	unsigned short slot;
+	unsigned short seq;
+	unsigned char found = 0;
+	unsigned short first = 0;
+	unsigned short last = 0;
+
+	for (slot = 0; slot < HISTORY_EE_PAGES; ++slot) {
+		if (eeprom_read_byte(HISTORY_EE_ADDR(slot, 0)) != HIST_KEY) { continue; }
+		seq = eeprom_read_byte(HISTORY_EE_ADDR(slot, 1)) | (eeprom_read_byte(HISTORY_EE_ADDR(slot, 2)) << 8);
+		if (!found || seq < first) { first = seq; }
+		if (!found || seq > last) { last = seq; }
+		found = 1;
+	}
+	histSeq = found ? last + 1 : 0;
+	histFirstSeq = found ? first : histSeq;
+	histSpillSeq = histSeq;
+	histSpillPos = 0;
+	histPos = 0;
+	histTicks = 0;
+	History_Event(HIST_EV_BOOT, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts a walk over the history, oldest record first
+//Parameter: The iterator to initialize
+//Returns: None
+void History_Begin(HistoryIter* it)
+{
+	it->seq = histFirstSeq;
+	it->pos = 0;
+	it->ms = 0;
+	it->sun = 0;
+	it->sample = 0;
+}
+
+unsigned short History_GetVar(HistoryIter* it)
+{
+	unsigned char b;
+	unsigned char shift = 0;
+	unsigned short v = 0;
+	do {
+		b = History_PageByte(it->seq, it->pos++);
+		v |= (unsigned short)(b & 0x7F) << shift;
+		shift += 7;
+	} while ((b & 0x80) && it->pos < HISTORY_PAGE);
+	return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Decodes the next record of a walk
+//Parameter: The iterator and the entry to fill in
+//Returns: 1 if an entry was produced, 0 at the end of the history
+unsigned char History_Next(HistoryIter* it, HistoryEntry* e)
+{
+	unsigned char tag;
+	unsigned short zz;
+
+	while (1) {
+		if (it->seq > histSeq || (it->seq == histSeq && histPos == 0)) { return 0; }
+		if (it->pos >= HISTORY_PAGE) {
+			++it->seq;
+			it->pos = 0;
+			continue;
+		}
+
+		tag = History_PageByte(it->seq, it->pos++);
+		if (tag == HIST_KEY) {
+			it->ms = History_PageByte(it->seq, 3);
+			it->sun = History_PageByte(it->seq, 4);
+			it->pos = HIST_KEY_LEN;
+			continue;
+		}
+		if (tag == HIST_END) {
+			it->pos = HISTORY_PAGE;
+			continue;
+		}
+
+		e->sample = it->sample;
+		if ((tag & 0xC0) == HIST_EVENT) {
+			e->event = tag & 0x3F;
+			e->arg = History_GetVar(it);
+		}
+		else {
+			if (tag == HIST_WIDE) {
+				zz = History_GetVar(it);
+				it->ms += (signed short)((zz >> 1) ^ -(zz & 1));
+				zz = History_GetVar(it);
+				it->sun += (signed short)((zz >> 1) ^ -(zz & 1));
+			}
+			else {
+				it->ms += (signed char)((tag >> 3) & 0x07) - 4;
+				it->sun += (signed char)(tag & 0x07) - 4;
+			}
+			++it->sample;
+			e->event = 0;
+			e->arg = 0;
+		}
+		e->ms = it->ms;
+		e->sun = it->sun;
+		return 1;
+	}
+}
+
+void History_SendNum(unsigned short v)
+{
+	unsigned char buf[FMT_U16_MAX + 1];
+	unsigned char i;
+	unsigned char n = Fmt_U16(buf, v, 1, '0', 0);
+	for (i = 0; i < n; ++i) { USART_Send(buf[i], CONSOLE_USART); }
+}
+
+HistoryIter histDump;				// walk of the dump under way
+unsigned char histDumping;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts dumping the whole history as CSV lines on the console
+//				  USART, "S,<sample>,<ms>,<sun>" or "E,<sample>,<event>,<arg>";
+//				  History_DumpStep() sends it
+//Parameter: None
+//Returns: None
+void History_DumpStart()
+{
+	History_Begin(&histDump);
+	histDumping = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends the next HISTORY_DUMP_LINES lines of a dump; call once
+//				  per task tick, so a full history takes a few minutes
+//Parameter: None
+//Returns: 1 while the dump goes on, 0 once it is done or if none was started
+unsigned char History_DumpStep()
+{
+	HistoryEntry e;
+	unsigned char n;
+
+	if (!histDumping) { return 0; }
+	for (n = 0; n < HISTORY_DUMP_LINES; ++n) {
+		// pages overwritten since the walk began are skipped
+		if (histDump.seq < histFirstSeq) {
+			histDump.seq = histFirstSeq;
+			histDump.pos = 0;
+		}
+		if (!History_Next(&histDump, &e)) {
+			histDumping = 0;
+			return 0;
+		}
+		USART_Send(e.event ? 'E' : 'S', CONSOLE_USART);
+		USART_Send(',', CONSOLE_USART);
+		History_SendNum(e.sample);
+		USART_Send(',', CONSOLE_USART);
+		History_SendNum(e.event ? e.event : e.ms);
+		USART_Send(',', CONSOLE_USART);
+		History_SendNum(e.event ? e.arg : e.sun);
+		USART_Send('\r', CONSOLE_USART);
+		USART_Send('\n', CONSOLE_USART);
+	}
+	return 1;
+}
+
+#endif //HISTORY_H
@@ -1,24 +1,32 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <stdio.h>
+#include <avr/pgmspace.h>
 #include "io.h"
-
-#define SET_BIT(p,i) ((p) |= (1 << (i)))
-#define CLR_BIT(p,i) ((p) &= ~(1 << (i)))
-#define GET_BIT(p,i) ((p) & (1 << (i)))
+#include "board.h"
+#include "bit.h"
           
 /*-------------------------------------------------------------------------*/
 
-#define DATA_BUS PORTC		// port connected to pins 7-14 of LCD display
-#define CONTROL_BUS PORTD	// port connected to pins 4 and 6 of LCD disp.
-#define RS 6			// pin number of uC connected to pin 4 of LCD disp.
-#define E 7
+#define DATA_BUS LCD_DATA_PORT	// port connected to pins 7-14 of LCD display
+#define CONTROL_BUS LCD_CTRL_PORT	// port connected to pins 4 and 6 of LCD disp.
+#define RS LCD_RS		// pin number of uC connected to pin 4 of LCD disp.
+#define E LCD_E
 
 /*-------------------------------------------------------------------------*/
 
+// With DISPLAY_REMOTE (board.h) the LCD is on the display servant, which
+// builds this file as it is; display.h then has the calls guarded below,
+// working on a copy of the screen.
+
+#if !DISPLAY_REMOTE
+static unsigned char lcdShift;	// display shift, DDRAM address shown in column 1
+
 void LCD_ClearScreen(void) {
    LCD_WriteCommand(0x01);
+   lcdShift = 0;				// the clear also undoes the shift
 }
+#endif
 
 void LCD_init(void) {
 
@@ -31,15 +39,41 @@ void LCD_init(void) {
 	delay_ms(10);						 
 }
 
-void LCD_WriteCommand (unsigned char Command) {
+void LCD_LatchCommand (unsigned char Command) {
    CLR_BIT(CONTROL_BUS,RS);
    DATA_BUS = Command;
    SET_BIT(CONTROL_BUS,E);
    asm("nop");
    CLR_BIT(CONTROL_BUS,E);
+}
+
+#if !DISPLAY_REMOTE
+static const unsigned char lcdInitSeq[] PROGMEM = { 0x38, 0x06, 0x0f, 0x01 };
+static unsigned char lcdInitWait = 100;	// power-on wait, ms
+static unsigned char lcdInitNext;
+
+unsigned char LCD_InitStep(void) {
+   // LCD_init() without the busy waits: call once per ms from power-on.
+   // Same commands, each given 2 ms (the clear needs 1.52 ms).
+   if (lcdInitWait) {
+      --lcdInitWait;
+      return 0;
+   }
+   if (lcdInitNext < sizeof(lcdInitSeq)) {
+      LCD_LatchCommand(pgm_read_byte(&lcdInitSeq[lcdInitNext++]));
+      lcdInitWait = 2;
+      return 0;
+   }
+   return 1;
+}
+#endif
+
+void LCD_WriteCommand (unsigned char Command) {
+   LCD_LatchCommand(Command);
    delay_ms(2); // ClearScreen requires 1.52ms to execute
 }
 
+#if !DISPLAY_REMOTE
 void LCD_WriteData(unsigned char Data) {
    SET_BIT(CONTROL_BUS,RS);
    DATA_BUS = Data;
@@ -48,13 +82,45 @@ void LCD_WriteData(unsigned char Data) {
    CLR_BIT(CONTROL_BUS,E);
    delay_ms(1);
 }
+#endif
 
 void LCD_DisplayString( unsigned char column, const unsigned char* string) {
    // LCD_ClearScreen();
+   // The entry mode set in LCD_init() auto-increments the address, so the
+   // cursor is only placed at the start and again when wrapping to row 2.
    unsigned char c = column;
+   LCD_Cursor(c);
    while(*string) {
-      LCD_Cursor(c++);
+      if (c == 17 && c != column) {
+         LCD_Cursor(c);
+      }
       LCD_WriteData(*string++);
+      c++;
+   }
+}
+
+void LCD_DisplayString_P( unsigned char column, const char* string) {
+   // Same as LCD_DisplayString() but reads the text straight from flash
+   unsigned char c = column;
+   unsigned char ch;
+   LCD_Cursor(c);
+   while((ch = pgm_read_byte(string++))) {
+      if (c == 17 && c != column) {
+         LCD_Cursor(c);
+      }
+      LCD_WriteData(ch);
+      c++;
+   }
+}
+
+#if !DISPLAY_REMOTE
+void LCD_DefineChar(unsigned char slot, const unsigned char* rows) {
+   // Loads the 5x8 pattern of character slot (0-7, also drawn as 8-15);
+   // the address counter is left in CGRAM, so place the cursor next.
+   unsigned char i;
+   LCD_WriteCommand(0x40 | (slot << 3));
+   for (i = 0; i < 8; ++i) {
+      LCD_WriteData(rows[i]);
    }
 }
 
@@ -68,6 +134,20 @@ void LCD_Cursor(unsigned char column) {
    }
 }
 
+void LCD_Shift(unsigned char shift) {
+   // Shifts both rows so column 1 shows DDRAM address shift of its line
+   // (0-39), one command per column moved; DDRAM and the cursor stay put.
+   while (lcdShift < shift) {
+      LCD_WriteCommand(0x18);
+      ++lcdShift;
+   }
+   while (lcdShift > shift) {
+      LCD_WriteCommand(0x1C);
+      --lcdShift;
+   }
+}
+#endif
+
 void delay_ms(int miliSec) //for 8 Mhz crystal
 
 {
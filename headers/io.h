@@ -2,10 +2,16 @@
 #define __io_h__
 
 void LCD_init();
+unsigned char LCD_InitStep(void);
 void LCD_ClearScreen(void);
+void LCD_LatchCommand (unsigned char Command);
 void LCD_WriteCommand (unsigned char Command);
+void LCD_WriteData(unsigned char Data);
 void LCD_Cursor (unsigned char column);
 void LCD_DisplayString(unsigned char column ,const unsigned char *string);
+void LCD_DisplayString_P(unsigned char column, const char *string);
+void LCD_DefineChar(unsigned char slot, const unsigned char *rows);
+void LCD_Shift(unsigned char shift);
 void delay_ms(int miliSec);
 #endif
 
@@ -6,7 +6,7 @@
 
 // Returns '\0' if no key pressed, else returns char '1', '2', ... '9', 'A', ...
 // If multiple keys pressed, returns leftmost-topmost one
-// Keypad must be connected to port C
+// Keypad port is set in board.h (KEYPAD_PORT)
 // Keypad arrangement
 //        Px4 Px5 Px6 Px7
 //	  col 1   2   3   4
@@ -19,13 +19,10 @@
 #ifndef KEYPAD_H
 #define KEYPAD_H
 
+#include "board.h"
 #include "bit.h"
 
-// Keypad Setup Values
-#define KEYPADPORT PORTB
-#define KEYPADPIN  PINB
-
-
+// Keypad Setup Values (port in board.h)
 #define ROW1 0
 #define ROW2 1
 #define ROW3 2
@@ -35,44 +32,63 @@
 #define COL3 6
 #define COL4 7
 
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Drives one column low and reads the rows back
+//Parameter: The column pin
+//Returns: The row bits, set where a key is pressed
+ALWAYS_INLINE unsigned char Keypad_Scan(unsigned char col)
+{
+	KEYPAD_PORT = (unsigned char)~(1 << col); // column low, others (and row pull-ups) high
+	asm("nop"); // add a delay to allow PORTx to stabilize before checking
+	return ~KEYPAD_PIN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Checks for any key with every column driven low at once
+//Parameter: None
+//Returns: Nonzero while a key is pressed
+ALWAYS_INLINE unsigned char Keypad_Any()
+{
+	KEYPAD_PORT = 0x0F; // all columns low, row pull-ups on
+	asm("nop");
+	return ~KEYPAD_PIN & 0x0F;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //Functionality - Gets input from a keypad via time-multiplexing
 //Parameter: None
 //Returns: A keypad button press else '\0'
-unsigned char GetKeypadKey() {
+static inline unsigned char GetKeypadKey() {
+	unsigned char rows;
 
 	// Check keys in col 1
-	KEYPADPORT = SetBit(0xFF,COL1,0); // Set Px4 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
-	if ( GetBit(~KEYPADPIN,ROW1) ) { return '1'; }
-	if ( GetBit(~KEYPADPIN,ROW2) ) { return '4'; }
-	if ( GetBit(~KEYPADPIN,ROW3) ) { return '7'; }
-	if ( GetBit(~KEYPADPIN,ROW4) ) { return '*'; }
+	rows = Keypad_Scan(COL1);
+	if ( GET_BIT(rows,ROW1) ) { return '1'; }
+	if ( GET_BIT(rows,ROW2) ) { return '4'; }
+	if ( GET_BIT(rows,ROW3) ) { return '7'; }
+	if ( GET_BIT(rows,ROW4) ) { return '*'; }
 
 	// Check keys in col 2
-	KEYPADPORT = SetBit(0xFF,COL2,0); // Set Px5 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
-	if ( GetBit(~KEYPADPIN,ROW1) ) { return '2'; }
-	if ( GetBit(~KEYPADPIN,ROW2) ) { return '5'; }
-	if ( GetBit(~KEYPADPIN,ROW3) ) { return '8'; }
-	if ( GetBit(~KEYPADPIN,ROW4) ) { return '0'; }
+	rows = Keypad_Scan(COL2);
+	if ( GET_BIT(rows,ROW1) ) { return '2'; }
+	if ( GET_BIT(rows,ROW2) ) { return '5'; }
+	if ( GET_BIT(rows,ROW3) ) { return '8'; }
+	if ( GET_BIT(rows,ROW4) ) { return '0'; }
 
 	// Check keys in col 3
-	KEYPADPORT = SetBit(0xFF,COL3,0); // Set Px6 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
-	if ( GetBit(~KEYPADPIN,ROW1) ) { return '3'; }
-	if ( GetBit(~KEYPADPIN,ROW2) ) { return '6'; }
-	if ( GetBit(~KEYPADPIN,ROW3) ) { return '9'; }
-	if ( GetBit(~KEYPADPIN,ROW4) ) { return '#'; }
+	rows = Keypad_Scan(COL3);
+	if ( GET_BIT(rows,ROW1) ) { return '3'; }
+	if ( GET_BIT(rows,ROW2) ) { return '6'; }
+	if ( GET_BIT(rows,ROW3) ) { return '9'; }
+	if ( GET_BIT(rows,ROW4) ) { return '#'; }
 
 	// Check keys in col 4
-	KEYPADPORT = SetBit(0xFF,COL4,0); // Set Px7 to 0; others 1
-	asm("nop"); // add a delay to allow PORTx to stabilize before checking
-	if (GetBit(~KEYPADPIN,ROW1) ) { return 'A'; }
-	if (GetBit(~KEYPADPIN,ROW2) ) { return 'B'; }
-	if (GetBit(~KEYPADPIN,ROW3) ) { return 'C'; }
-	if (GetBit(~KEYPADPIN,ROW4) ) { return 'D'; }
-	
+	rows = Keypad_Scan(COL4);
+	if ( GET_BIT(rows,ROW1) ) { return 'A'; }
+	if ( GET_BIT(rows,ROW2) ) { return 'B'; }
+	if ( GET_BIT(rows,ROW3) ) { return 'C'; }
+	if ( GET_BIT(rows,ROW4) ) { return 'D'; }
+
 	return '\0';
 }
 
@@ -0,0 +1,132 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Table driven menu engine. Each state is one flash-resident Screen row:
+// where every joystick direction leads, the static text drawn on entry and
+// optional callbacks. Dispatch is a single indexed table read per tick.
+// A screen is only repainted in place when one of the inputs it declares in
+// deps changed since the last tick, so a static screen costs a table read.
+//
+//   next[]  next state for DIR_NONE/UP/DOWN/LEFT/RIGHT; the row's own index
+//           means stay. A transient screen names its successor in DIR_NONE.
+//   text    flash string drawn from column 1 after the clear, 0 for none
+//   enter   side effects run once on entry (save, retrieve, ...)
+//   draw    paints the dynamic fields, on entry and whenever poll asks
+//   poll    runs every tick the screen stays, returns 1 to request a draw
+//   ready   gates the RIGHT transition (e.g. until a key was entered)
+//   deps    MENU_DEP_ inputs poll looks at; poll is skipped unless one changed
+//   flags   MENU_ flags below, 0 for none
+
+#ifndef MENU_H
+#define MENU_H
+
+#include <avr/pgmspace.h>
+#include "io.h"
+#include "glyph.h"
+#include "viewport.h"
+#include "trace.h"
+
+#define DIR_NONE  0
+#define DIR_UP    1
+#define DIR_DOWN  2
+#define DIR_LEFT  3
+#define DIR_RIGHT 4
+#define DIR_COUNT 5
+
+// Inputs a screen can depend on, passed to Menu_Step() as a changed mask
+#define MENU_DEP_DIR    0x01			// joystick held off center
+#define MENU_DEP_KEY    0x02			// keypad key pressed or released
+#define MENU_DEP_SENSOR 0x04			// a moisture or light reading
+#define MENU_DEP_STACK  0x08			// stack monitor figures
+#define MENU_DEP_LIVE   (MENU_DEP_SENSOR | MENU_DEP_STACK)	// change without input
+
+// Screen flags
+#define MENU_SCROLL     0x01			// text is one prompt along row 1, scrolled (viewport.h)
+
+typedef struct Screen {
+	unsigned char next[DIR_COUNT];
+	const char* text;
+	void (*enter)(void);
+	void (*draw)(void);
+	unsigned char (*poll)(unsigned char dir, unsigned char key);
+	unsigned char (*ready)(void);
+	unsigned char deps;
+	unsigned char flags;
+} Screen;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Clears the display and brings up a screen
+//Parameter: The screen table in flash and the state to enter
+//Returns: The state entered
+unsigned char Menu_Enter(const Screen* table, unsigned char s)
+{
+	const Screen* row = &table[s];
+	const char* text = (const char*)pgm_read_ptr(&row->text);
+	void (*fn)(void);
+
+	Trace(TRACE_STATE, s);
+	Trace(TRACE_LCD_BEGIN, TRACE_LCD_SCREEN);
+	LCD_ClearScreen();
+	Glyph_NewScreen();
+	View_Reset();
+	if (text && (pgm_read_byte(&row->flags) & MENU_SCROLL)) { View_Show_P(text); }
+	else if (text) { LCD_DisplayString_P(1, text); }
+	Trace(TRACE_LCD_END, TRACE_LCD_SCREEN);
+	fn = (void (*)(void))pgm_read_ptr(&row->enter);
+	if (fn) { fn(); }
+	fn = (void (*)(void))pgm_read_ptr(&row->draw);
+	if (fn) {
+		Trace(TRACE_LCD_BEGIN, TRACE_LCD_FIELDS);
+		fn();
+		Trace(TRACE_LCD_END, TRACE_LCD_FIELDS);
+	}
+	return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Gets the inputs a screen depends on
+//Parameter: The screen table in flash and the state
+//Returns: Its MENU_DEP_ mask
+unsigned char Menu_Deps(const Screen* table, unsigned char s)
+{
+	return pgm_read_byte(&table[s].deps);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Runs one menu tick: transition on input or refresh in place
+//Parameter: The screen table in flash, the current state,
+//			 the joystick direction (DIR_), the keypad key ('\0' if none)
+//			 and the MENU_DEP_ inputs that changed since the last tick
+//Returns: The new state
+unsigned char Menu_Step(const Screen* table, unsigned char s, unsigned char dir, unsigned char key, unsigned char changed)
+{
+	const Screen* row = &table[s];
+	unsigned char next = pgm_read_byte(&row->next[dir]);
+	unsigned char (*ready)(void);
+	unsigned char (*poll)(unsigned char, unsigned char);
+	void (*draw)(void);
+
+	if (next != s && dir == DIR_RIGHT) {
+		ready = (unsigned char (*)(void))pgm_read_ptr(&row->ready);
+		if (ready && !ready()) { next = s; }
+	}
+	if (next != s) {
+		return Menu_Enter(table, next);
+	}
+
+	if (!(pgm_read_byte(&row->deps) & changed)) { return s; }
+	poll = (unsigned char (*)(unsigned char, unsigned char))pgm_read_ptr(&row->poll);
+	if (poll && poll(dir, key)) {
+		draw = (void (*)(void))pgm_read_ptr(&row->draw);
+		if (draw) {
+			Trace(TRACE_LCD_BEGIN, TRACE_LCD_FIELDS);
+			draw();
+			Trace(TRACE_LCD_END, TRACE_LCD_FIELDS);
+		}
+	}
+	return s;
+}
+
+#endif //MENU_H
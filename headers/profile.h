@@ -0,0 +1,111 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// RAM-resident cache of the plant profiles stored in EEPROM.
+// All slots are pulled into SRAM once at boot; after that every read is
+// served from the cache and a save only programs the EEPROM bytes that
+// actually differ from what is already stored.
+//
+// EEPROM layout (slot numbers are the 1..4 keyed in on the keypad)
+//   addr PROFILE_EE_BASE + (slot - 1) * PROFILE_RECORD   the fields up to waterMs
+//   addr PROFILE_EE_PULSE + (slot - 1) * 2               waterMs
+// waterMs came later and has a table of its own, so the records stayed where
+// older firmware put them; there it reads as blank and the default applies.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include "trace.h"
+
+#define PROFILE_SLOTS 4
+#define PROFILE_EE_BASE 1
+#define PROFILE_EE_PULSE 25			// after the four records
+#define PROFILE_WATER_MS 100		// pulse for a slot saved without a length
+#define PROFILE_WATER_MAX 65500		// longest pulse that can be keyed in, ms
+
+typedef struct PlantProfile {
+	unsigned char dayTimeWaterOK;
+	unsigned char waterFrequency;
+	unsigned short moisture;		// thresholds in calibrated units (calib.h)
+	unsigned short sunLevel;
+	unsigned short waterMs;			// valve pulse per watering
+} PlantProfile;
+
+PlantProfile profileCache[PROFILE_SLOTS];
+
+#define PROFILE_RECORD offsetof(PlantProfile, waterMs)
+#define PROFILE_EE_ADDR(slot) ((unsigned char*)(PROFILE_EE_BASE + ((slot) - 1) * PROFILE_RECORD))
+#define PROFILE_EE_PULSE_ADDR(slot) ((unsigned char*)(PROFILE_EE_PULSE + ((slot) - 1) * 2))
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Checks that a slot number refers to a stored profile
+//Parameter: Slot number 1..PROFILE_SLOTS
+//Returns: 1 if valid else 0
+unsigned char Profile_IsSlot(unsigned char slot)
+{
+	return (slot >= 1 && slot <= PROFILE_SLOTS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Pulse length of a profile, with the default for blank EEPROM
+//Parameter: The profile
+//Returns: Pulse length in ms
+unsigned short Profile_WaterMs(const PlantProfile* p)
+{
+	return (p->waterMs == 0 || p->waterMs > PROFILE_WATER_MAX) ? PROFILE_WATER_MS : p->waterMs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Loads every profile slot from EEPROM into the SRAM cache
+//Parameter: None
+//Returns: None
+void Profile_LoadCache()
+{
+	unsigned char s;
+	for (s = 1; s <= PROFILE_SLOTS; ++s) {
+		eeprom_read_block(&profileCache[s - 1], PROFILE_EE_ADDR(s), PROFILE_RECORD);
+		eeprom_read_block(&profileCache[s - 1].waterMs, PROFILE_EE_PULSE_ADDR(s), sizeof(profileCache[0].waterMs));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reads a profile out of the cache, no EEPROM access
+//Parameter: Slot number 1..PROFILE_SLOTS
+//Returns: Pointer to the cached profile, or 0 for an invalid slot
+const PlantProfile* Profile_Get(unsigned char slot)
+{
+	return Profile_IsSlot(slot) ? &profileCache[slot - 1] : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes a profile back, programming only the changed bytes
+//Parameter: The new profile contents and the slot number 1..PROFILE_SLOTS
+//Returns: Number of EEPROM bytes that were programmed
+unsigned char Profile_Put(const PlantProfile* p, unsigned char slot)
+{
+	unsigned char i;
+	unsigned char written = 0;
+	const unsigned char* src = (const unsigned char*)p;
+	unsigned char* cached;
+	unsigned char* ee;
+
+	if (!Profile_IsSlot(slot)) { return 0; }
+
+	cached = (unsigned char*)&profileCache[slot - 1];
+	for (i = 0; i < sizeof(PlantProfile); ++i) {
+		if (cached[i] != src[i]) {
+			ee = (i < PROFILE_RECORD) ? PROFILE_EE_ADDR(slot) + i : PROFILE_EE_PULSE_ADDR(slot) + i - PROFILE_RECORD;
+			eeprom_write_byte(ee, src[i]);
+			Trace(TRACE_EEPROM, TRACE_EE_PROFILE);
+			cached[i] = src[i];
+			++written;
+		}
+	}
+	return written;
+}
+
+#endif //PROFILE_H
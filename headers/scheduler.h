@@ -8,12 +8,25 @@
 #define SCHEDULER_H
 
 #include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include "board.h"
+#include "stackmon.h"
+#include "trace.h"
+#include "valve.h"
+
+// Compare value for a 1 ms tick at F_CPU with the /64 prescaler
+#define SCHED_TICK_TOP (F_CPU / 64 / 1000)
 
 // Internal variables for mapping AVR's ISR to our cleaner TimerISR model.
 unsigned long tasksPeriodGCD = 1; // Start count from here, down to 0. Default 1ms
 unsigned long tasksPeriodCntDown = 0; // Current internal count of 1ms ticks
 
 unsigned char tasksNum = 0; // Number of tasks in the scheduler. Default 0 tasks
+unsigned char tasksRan = 0; // Tasks that ticked this round, one bit each
+void (*tasksRoundFct)(void) = 0; // Called once every task has ticked, before the watchdog is fed
+void (*tasksMsFct)(void) = 0; // Called on every 1ms tick while set, for short boot-time steps
+unsigned short tasksMs = 0; // 1ms ticks since TimerOn(), wraps after 65 s
+volatile unsigned char tasksRunning = 0; // Set while TimerISR() runs with interrupts enabled
 
 ////////////////////////////////////////////////////////////////////////////////
 // Struct for Tasks represent a running process in our simple real-time operating system
@@ -28,56 +41,85 @@ task* tasks;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Heart of the scheduler code
-void TimerISR() {
+static inline void TimerISR() {
     static unsigned char i;
     for (i = 0; i < tasksNum; i++) { 
         if ( tasks[i].elapsedTime >= tasks[i].period ) { // Ready
+            StackMon_TaskBegin(i);
+            Trace(TRACE_TASK_BEGIN, i);
             tasks[i].state = tasks[i].TickFct(tasks[i].state);
+            Trace(TRACE_TASK_END, i);
+            StackMon_TaskEnd(i);
             tasks[i].elapsedTime = 0;
+            tasksRan |= 1 << i;
         }
         tasks[i].elapsedTime += tasksPeriodGCD;
     }
+    // The watchdog is only fed once every task has completed a round, so a
+    // task that never returns (or never gets its turn) resets the part
+    if (tasksRan == (unsigned char)((1 << tasksNum) - 1)) {
+        tasksRan = 0;
+        if (tasksRoundFct) { tasksRoundFct(); }
+        wdt_reset();
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // In our approach, the C programmer does not touch this ISR, but rather TimerISR()
-ISR(TIMER1_COMPA_vect) {
-	// CPU automatically calls when TCNT0 == OCR0 (every 1 ms per TimerOn settings)
+ISR(TIMER1_OVF_vect) {
+	// CPU automatically calls when TCNT1 wraps at ICR1 (every 1 ms per TimerOn settings)
+	Valve_Tick();					// first, so a pulse ends on time
+	StackMon_Isr(STACKMON_ISR_TIMER1);
+	++tasksMs;
+	unsigned char traced = TRACE_TICKS || tasksPeriodCntDown == 1;
+	if (traced) { Trace(TRACE_ISR_BEGIN, STACKMON_ISR_TIMER1); }
+	if (tasksMsFct) { tasksMsFct(); }
 	tasksPeriodCntDown--; 			// Count down to 0 rather than up to TOP
+	if (traced) { Trace(TRACE_ISR_END, STACKMON_ISR_TIMER1); }	// the tasks below trace themselves
 	if (tasksPeriodCntDown == 0) { 	// results in a more efficient compare
-		TimerISR(); 				// Call the ISR that the user uses
 		tasksPeriodCntDown = tasksPeriodGCD;
+		// Tasks run with interrupts enabled so the 1 ms tick above keeps
+		// its timing while they work; a round still running is not
+		// re-entered, the late one is skipped
+		if (!tasksRunning) {
+			tasksRunning = 1;
+			sei();
+			TimerISR(); 			// Call the ISR that the user uses
+			cli();
+			tasksRunning = 0;
+		}
 	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Set TimerISR() to tick every m ms
-void TimerSet(unsigned long m) {
+static inline void TimerSet(unsigned long m) {
 	tasksPeriodGCD = m;
 	tasksPeriodCntDown = tasksPeriodGCD;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void TimerOn() {
-	// AVR timer/counter controller register TCCR1
-	TCCR1B 	= (1<<WGM12)|(1<<CS11)|(1<<CS10);
-                    // WGM12 (bit3) = 1: CTC mode (clear timer on compare)
+static inline void TimerOn() {
+	// AVR timer/counter controller registers TCCR1A/B
+	TCCR1A 	= (1<<WGM11);
+	TCCR1B 	= (1<<WGM13)|(1<<WGM12)|(1<<CS11)|(1<<CS10);
+                    // WGM13:0 = 1110: fast PWM, TOP = ICR1
 					// CS12,CS11,CS10 (bit2bit1bit0) = 011: prescaler /64
-					// Thus TCCR1B = 00001011 or 0x0B
 					// So, 8 MHz clock or 8,000,000 /64 = 125,000 ticks/s
 					// Thus, TCNT1 register will count at 125,000 ticks/s
+					// OCR1A is left to the valve drive on OC1A (valve.h)
 
-	// AVR output compare register OCR1A.
-	OCR1A 	= 125;	// Timer interrupt will be generated when TCNT1==OCR1A
+	// AVR input capture register ICR1, used as TOP.
+	ICR1 	= SCHED_TICK_TOP;	// Timer interrupt will be generated when TCNT1 wraps
 					// We want a 1 ms tick. 0.001 s * 125,000 ticks/s = 125
-					// So when TCNT1 register equals 125,
-					// 1 ms has passed. Thus, we compare to 125.
+					// So when TCNT1 register reaches 125,
+					// 1 ms has passed. Thus, TOP is 125.
 					// AVR timer interrupt mask register
 
 #if defined (__AVR_ATmega1284__)
-    TIMSK1 	= (1<<OCIE1A); // OCIE1A (bit1): enables compare match interrupt - ATMega1284
+    TIMSK1 	= (1<<TOIE1); // TOIE1 (bit0): enables overflow interrupt - ATMega1284
 #else
-    TIMSK 	= (1<<OCIE1A); // OCIE1A (bit1): enables compare match interrupt - ATMega32
+    TIMSK 	= (1<<TOIE1); // TOIE1 (bit2): enables overflow interrupt - ATMega32
 #endif
 
 	// Initialize avr counter
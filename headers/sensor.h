@@ -0,0 +1,87 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Sensor supply gating. The moisture probes and light sensors are fed from
+// one switched pin instead of the board supply, so they only draw current
+// (and a resistive probe only sees DC, which corrodes it) around a sample.
+//
+// The zone samples are taken once per 100 ms task round, by the 1 ms tick
+// that starts the round. Sensor_Tick() switches the supply on SENSOR_SETTLE_MS
+// ahead of that tick and tells the caller when to sample; Zone_Sample()
+// switches it off once the channels are read. With a 2 ms settle the sensors
+// are powered about 2% of the time. A sample taken outside the tick (at boot)
+// powers the sensors up itself and waits out the settle time. A closed-loop
+// watering, which samples every 1 ms, holds the supply on until it ends.
+
+#ifndef SENSOR_H
+#define SENSOR_H
+
+#include <avr/io.h>
+#include "board.h"
+#include "bit.h"
+#include "scheduler.h"
+#include "io.h"
+
+// Sensor Setup Values
+#ifndef SENSOR_SETTLE_MS
+#define SENSOR_SETTLE_MS 2			// supply on this long before a sample
+#endif
+
+unsigned char sensorHold;			// set while a watering samples every ms
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Makes the supply pin an output, sensors off
+//Parameter: None
+//Returns: None
+void Sensor_Init()
+{
+	CLR_BIT(SENSOR_PWR_PORT, SENSOR_PWR_BIT);
+	SET_BIT(SENSOR_PWR_DDR, SENSOR_PWR_BIT);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Powers the sensors up ahead of the next task round; call
+//				  every 1 ms, before the scheduler counts down
+//Parameter: None
+//Returns: 1 on the tick that starts the round, when the sensors have settled
+ALWAYS_INLINE unsigned char Sensor_Tick()
+{
+	if (tasksPeriodCntDown <= SENSOR_SETTLE_MS + 1) { SET_BIT(SENSOR_PWR_PORT, SENSOR_PWR_BIT); }
+	return tasksPeriodCntDown == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Makes sure the sensors are powered and settled, waiting out
+//				  the settle time if the tick did not power them up already
+//Parameter: None
+//Returns: None
+void Sensor_On()
+{
+	if (GET_BIT(SENSOR_PWR_PORT, SENSOR_PWR_BIT)) { return; }
+	SET_BIT(SENSOR_PWR_PORT, SENSOR_PWR_BIT);
+	delay_ms(SENSOR_SETTLE_MS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Switches the sensors off after a sample, unless held
+//Parameter: None
+//Returns: None
+void Sensor_Off()
+{
+	if (!sensorHold) { CLR_BIT(SENSOR_PWR_PORT, SENSOR_PWR_BIT); }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Keeps the sensors powered for sampling every tick, or lets
+//				  the next Sensor_Off() switch them off; safe from the tick
+//Parameter: 1 to hold, 0 to release
+//Returns: None
+void Sensor_Hold(unsigned char hold)
+{
+	sensorHold = hold;
+	if (hold) { SET_BIT(SENSOR_PWR_PORT, SENSOR_PWR_BIT); }
+}
+
+#endif //SENSOR_H
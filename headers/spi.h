@@ -1,58 +1,45 @@
 #ifndef SPI_H_
 #define SPI_H_
 
+#include <avr/io.h>
+#include "board.h"
 #include "bit.h"
 
-unsigned char newData;
-unsigned char uC;
-
 // Master code
-void SPI_MasterInit() {
-	// Set DDRB to have MOSI, SCK, and SS as output and MISO as input
-	DDRB = 0xBF; PORTB = 0x40;
+static inline void SPI_MasterInit() {
+	// MOSI, SCK and SS as outputs, SS high (deselected); MISO as input with
+	// its pull-up, so a missing servant reads 0xFF
+	SPI_DDR |= (1 << SPI_MOSI) | (1 << SPI_SCK) | (1 << SPI_SS);
+	SPI_DDR &= ~(1 << SPI_MISO);
+	SPI_PORT |= (1 << SPI_SS) | (1 << SPI_MISO);
 	// Set SPCR register to enable SPI, enable master, and use SCK frequency
 	//   of fosc/16  (pg. 168)
 	SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPR0 );
-	
-	// Make sure global interrupts are enabled on SREG register (pg. 9)
-	SREG = 0x80;
-	uC = 0x01;
 }
 
-void SPI_MasterTransmit(unsigned char cData) {
-	// data in SPDR will be transmitted, e.g. SPDR = cData;
-	// set SS low
-	PORTB = SetBit( PORTB, 4, 0);
-
+static inline unsigned char SPI_MasterTransfer(unsigned char cData) {
+	// SS is left to the caller, so several bytes can make up one frame
 	/* Start transmission */
 	SPDR = cData;
 	/* Wait for transmission complete */
-	while(!(SPSR & (1<<SPIF)));		PORTB = SetBit(PORTB, 4, 1);	sei();
+	while(!(SPSR & (1<<SPIF)));
+	return SPDR;
 }
 
-// Servant code
-void SPI_ServantInit() {
-	// set DDRB to have MISO line as output and MOSI, SCK, and SS as input
-	// set SPCR register to enable SPI and enable SPI interrupt (pg. 168)
-	// make sure global interrupts are enabled on SREG register (pg. 9)
-	
-	 /* Set MISO output, all others input */
-	 /* Enable SPI */
-	 DDRB |= 0x40; //PORTB = 0xBF;
-	 
-	 SPCR |= (1 << SPE) | (1 << SPIE);
-	 SREG= 0x80;
-	 uC = 0x02;
-	 sei();
+static inline void SPI_MasterTransmit(unsigned char cData) {
+	// set SS low
+	CLR_BIT(SPI_PORT, SPI_SS);
+	SPI_MasterTransfer(cData);
+	SET_BIT(SPI_PORT, SPI_SS);
 }
 
-ISR(SPI_STC_vect) { // this is enabled in with the SPCR registers SPI
-	// Interrupt Enable
-	// SPDR contains the received data, e.g. unsigned char receivedData =
-	// SPDR;
-	newData = SPDR;
+// Servant code
+static inline void SPI_ServantInit() {
+	// set MISO as output and MOSI, SCK and SS as inputs
+	// set SPCR register to enable SPI and enable SPI interrupt (pg. 168);
+	// the servant firmware defines ISR(SPI_STC_vect) and enables interrupts
+	SPI_DDR |= (1 << SPI_MISO);
+	SPCR |= (1 << SPE) | (1 << SPIE);
 }
 
-
-
-#endif /* SPI_H_ */
\ No newline at end of file
+#endif /* SPI_H_ */
@@ -0,0 +1,193 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Stack monitor. Tasks, ISRs and main() share the one stack that grows down
+// from RAMEND towards .bss. At boot every free byte is painted with a canary;
+// the deepest byte that no longer holds it is the high-water mark.
+//
+// The whole-RAM mark is found by a scan up from the end of .bss, done a chunk
+// at a time so it never costs a task more than a few hundred cycles. Per task
+// figures come from a band of canaries painted just below the task's known
+// depth before each call and checked after it; a task that goes deeper dirties
+// the band and its figure grows (by up to STACKMON_BAND bytes per call). ISRs
+// record the depth they were entered at.
+//
+// Console: "P,<peak>,<free>", then "T,<task>,<bytes>" and "I,<isr>,<bytes>".
+
+#ifndef STACKMON_H
+#define STACKMON_H
+
+#include <avr/io.h>
+#include "board.h"
+#include "bit.h"
+#include "usart.h"
+#include "fmt.h"
+
+// Stack Monitor Setup Values
+#define STACKMON_CANARY 0xC5
+#define STACKMON_BAND   32			// canaries painted below a task's depth
+#define STACKMON_CHUNK  128			// bytes checked per StackMon_Scan() call
+#define STACKMON_TASKS  4			// must cover tasksNum
+#define STACKMON_ISRS   1
+
+#define STACKMON_ISR_TIMER1 0
+
+unsigned short stackPeak;			// deepest use below RAMEND, bytes
+unsigned short stackTaskPeak[STACKMON_TASKS];	// bytes a task used below its call
+unsigned short stackIsrPeak[STACKMON_ISRS];	// stack depth an ISR was entered at
+unsigned char* stackTaskSp;			// SP the running task was called with
+unsigned char* stackScanAt;			// where the next scan chunk starts
+
+#if defined(__AVR__)
+
+extern unsigned char __heap_start;	// first byte after .bss, from the linker
+#define STACKMON_BOTTOM (&__heap_start)
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Paints the canary from the end of .bss up to RAMEND
+//				  Runs from .init5: .data and .bss are set up and nothing
+//				  is on the stack yet
+//Parameter: None
+//Returns: None
+void StackMon_Paint(void) __attribute__((naked, used, section(".init5")));
+void StackMon_Paint(void)
+{
+	unsigned char* p = STACKMON_BOTTOM;
+	while (p <= (unsigned char*)RAMEND) { *p++ = STACKMON_CANARY; }
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Bytes between .bss and the deepest stack use seen so far
+//Parameter: None
+//Returns: Free SRAM in bytes
+unsigned short StackMon_Free()
+{
+#if defined(__AVR__)
+	return (unsigned short)(RAMEND + 1 - (unsigned short)STACKMON_BOTTOM) - stackPeak;
+#else
+	return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Checks the next chunk of the painted area for the first
+//				  byte the stack has written, starting over after each find
+//Parameter: None
+//Returns: 1 when a pass finished and stackPeak is current, else 0
+unsigned char StackMon_Scan()
+{
+#if defined(__AVR__)
+	unsigned char* p = stackScanAt ? stackScanAt : STACKMON_BOTTOM;
+	unsigned char n = STACKMON_CHUNK;
+
+	while (n--) {
+		if (*p != STACKMON_CANARY || p == (unsigned char*)RAMEND) {
+			if ((unsigned short)(RAMEND + 1 - (unsigned short)p) > stackPeak) {
+				stackPeak = RAMEND + 1 - (unsigned short)p;
+			}
+			stackScanAt = STACKMON_BOTTOM;
+			return 1;
+		}
+		++p;
+	}
+	stackScanAt = p;
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records the stack depth at ISR entry; call first in the ISR
+//				  Forced inline so SP is read in the ISR's own frame
+//Parameter: STACKMON_ISR_ number
+//Returns: None
+ALWAYS_INLINE void StackMon_Isr(unsigned char id)
+{
+#if defined(__AVR__)
+	unsigned short depth = RAMEND - SP;
+	if (depth > stackIsrPeak[id]) { stackIsrPeak[id] = depth; }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Paints the band just below task i's known depth
+//				  Forced inline so SP is the one the task is called with
+//Parameter: Task number
+//Returns: None
+ALWAYS_INLINE void StackMon_TaskBegin(unsigned char i)
+{
+#if defined(__AVR__)
+	unsigned char* p;
+	unsigned char n = STACKMON_BAND;
+
+	stackTaskSp = (unsigned char*)SP;
+	p = stackTaskSp - stackTaskPeak[i];
+	if (p - STACKMON_BAND <= STACKMON_BOTTOM) { return; }
+	while (n--) { *p-- = STACKMON_CANARY; }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Finds the lowest dirty byte of task i's band and grows its
+//				  figure (and the whole-RAM mark) when the task went deeper
+//Parameter: Task number
+//Returns: None
+ALWAYS_INLINE void StackMon_TaskEnd(unsigned char i)
+{
+#if defined(__AVR__)
+	unsigned char* p = stackTaskSp - stackTaskPeak[i] - (STACKMON_BAND - 1);
+	unsigned char n = STACKMON_BAND;
+
+	if (p <= STACKMON_BOTTOM) { return; }
+	while (n && *p == STACKMON_CANARY) { ++p; --n; }
+	if (n) {
+		stackTaskPeak[i] = stackTaskSp - p + 1;
+		// the band is repainted next call, so the scan may never see this
+		if ((unsigned short)(RAMEND + 1 - (unsigned short)p) > stackPeak) {
+			stackPeak = RAMEND + 1 - (unsigned short)p;
+		}
+	}
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends "<tag>,<a>,<b>" and a line end on the console USART
+//Parameter: Tag character and the two values
+//Returns: None
+void StackMon_SendLine(unsigned char tag, unsigned short a, unsigned short b)
+{
+	unsigned char buf[FMT_U16_MAX + 1];
+	unsigned char i, n;
+
+	USART_Send(tag, CONSOLE_USART);
+	USART_Send(',', CONSOLE_USART);
+	n = Fmt_U16(buf, a, 1, '0', 0);
+	for (i = 0; i < n; ++i) { USART_Send(buf[i], CONSOLE_USART); }
+	USART_Send(',', CONSOLE_USART);
+	n = Fmt_U16(buf, b, 1, '0', 0);
+	for (i = 0; i < n; ++i) { USART_Send(buf[i], CONSOLE_USART); }
+	USART_Send('\r', CONSOLE_USART);
+	USART_Send('\n', CONSOLE_USART);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// **** WARNING: THIS FUNCTION BLOCKS MULTI-TASKING; USE WITH CAUTION!!! ****
+//Functionality - Finishes a scan pass and reports every figure on the console
+//Parameter: None
+//Returns: None
+void StackMon_Report()
+{
+	unsigned char i;
+
+	while (!StackMon_Scan()) {}
+	StackMon_SendLine('P', stackPeak, StackMon_Free());
+	for (i = 0; i < STACKMON_TASKS; ++i) { StackMon_SendLine('T', i, stackTaskPeak[i]); }
+	for (i = 0; i < STACKMON_ISRS; ++i) { StackMon_SendLine('I', i, stackIsrPeak[i]); }
+}
+
+#endif //STACKMON_H
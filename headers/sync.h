@@ -0,0 +1,123 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Lock-free exchange between the 1 ms tick and the tasks. Tasks run with
+// interrupts enabled (scheduler.h), so the tick can land in the middle of a
+// task reading a multi-byte value; a task never lands inside the tick, and
+// tasks never interrupt each other. Neither read path below disables
+// interrupts.
+//
+// SeqLock: for state the tick writes and tasks read. The writer makes seq odd,
+// writes, then makes it even again; a reader copies the data and retries if
+// seq was odd or moved meanwhile. The writer never waits, so it can be the
+// tick. The reverse direction needs no lock: the tick cannot be interrupted
+// by a task, so a task only has to make its own multi-byte store atomic.
+//
+// EventQueue: single producer, single consumer ring of small records. Only
+// the producer writes head and only the consumer writes tail, and both are
+// single bytes, so each side reads the other's index in one load.
+
+#ifndef SYNC_H
+#define SYNC_H
+
+#include "bit.h"
+
+// Sync Setup Values
+#define QUEUE_SIZE 8				// records per queue, a power of two up to 128
+
+// Keeps the compiler from moving memory accesses across the index updates
+#define SYNC_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+typedef struct SeqLock {
+	volatile unsigned char seq;
+} SeqLock;
+
+typedef struct QueueEvent {
+	unsigned char type;
+	unsigned short arg;
+} QueueEvent;
+
+typedef struct EventQueue {
+	QueueEvent buf[QUEUE_SIZE];
+	volatile unsigned char head;	// records put, free running
+	volatile unsigned char tail;	// records taken, free running
+} EventQueue;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Marks the protected data as being written
+//Parameter: The lock
+//Returns: None
+ALWAYS_INLINE void Seq_WriteBegin(SeqLock* l)
+{
+	l->seq = l->seq + 1;
+	SYNC_BARRIER();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Publishes the protected data
+//Parameter: The lock
+//Returns: None
+ALWAYS_INLINE void Seq_WriteEnd(SeqLock* l)
+{
+	SYNC_BARRIER();
+	l->seq = l->seq + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts a read; copy the data, then check Seq_ReadRetry()
+//Parameter: The lock
+//Returns: The sequence to pass to Seq_ReadRetry()
+ALWAYS_INLINE unsigned char Seq_ReadBegin(SeqLock* l)
+{
+	unsigned char s = l->seq;
+	SYNC_BARRIER();
+	return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Checks whether the copy taken since Seq_ReadBegin() is whole
+//Parameter: The lock and the sequence Seq_ReadBegin() returned
+//Returns: 1 if the data changed under the reader and it must copy again
+ALWAYS_INLINE unsigned char Seq_ReadRetry(SeqLock* l, unsigned char s)
+{
+	SYNC_BARRIER();
+	return (s & 1) || l->seq != s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Appends a record; producer side only
+//Parameter: The queue, the record type and its argument
+//Returns: 1 if queued, 0 if the queue was full and the record dropped
+unsigned char Queue_Put(EventQueue* q, unsigned char type, unsigned short arg)
+{
+	unsigned char h = q->head;
+	QueueEvent* e;
+
+	if ((unsigned char)(h - q->tail) >= QUEUE_SIZE) { return 0; }
+	e = &q->buf[h & (QUEUE_SIZE - 1)];
+	e->type = type;
+	e->arg = arg;
+	SYNC_BARRIER();
+	q->head = h + 1;
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Takes the oldest record; consumer side only
+//Parameter: The queue and where to copy the record
+//Returns: 1 if a record was taken, 0 if the queue was empty
+unsigned char Queue_Get(EventQueue* q, QueueEvent* out)
+{
+	unsigned char t = q->tail;
+
+	if (t == q->head) { return 0; }
+	SYNC_BARRIER();
+	*out = q->buf[t & (QUEUE_SIZE - 1)];
+	SYNC_BARRIER();
+	q->tail = t + 1;
+	return 1;
+}
+
+#endif //SYNC_H
@@ -0,0 +1,142 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Event trace. Trace points store a 4-byte record in an SRAM ring: a 16-bit
+// timestamp, an event type and one byte of argument. The timestamp is the
+// 1 ms tick count in the top bits and TCNT1 (0..SCHED_TICK_TOP, 8 us steps at
+// /64) in the low 7, so it wraps every 512 ms; a task round leaves records
+// every 100 ms, so the host can unwrap it from the differences. A trace point
+// is a few loads and stores with interrupts off, about 30 cycles, and costs
+// nothing with TRACE_ENABLE set to 0.
+//
+// The tick ISR is traced on the ticks that start a task round (and take the
+// sensor sample); tracing all 1000 a second would fill the ring in 64 ms.
+// Set TRACE_TICKS to 1 to see every tick.
+//
+// The ring keeps the last TRACE_SIZE records; slots never written hold
+// TRACE_NONE. It is not cleared by a dump.
+//
+// Console: 'T' dumps the ring in binary, oldest record first:
+//   "TRC" <TRACE_SIZE> then TRACE_SIZE records of <time lo> <time hi> <type> <arg>
+// host/trace2json turns a dump into Chrome trace-event JSON.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "board.h"
+#include "bit.h"
+#include "usart.h"
+
+// Trace Setup Values
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1
+#endif
+#ifndef TRACE_TICKS
+#define TRACE_TICKS 0				// 1 to trace every tick, not just the round ones
+#endif
+#define TRACE_SIZE 128				// records, a power of two up to 128
+#define TRACE_DUMP_RECS 8			// records per Trace_DumpStep(), 33 ms at 9600 baud
+
+// Event types; the argument is in brackets
+enum {
+	TRACE_NONE,
+	TRACE_TASK_BEGIN,				// task number
+	TRACE_TASK_END,					// task number
+	TRACE_ISR_BEGIN,				// STACKMON_ISR_ number
+	TRACE_ISR_END,					// STACKMON_ISR_ number
+	TRACE_STATE,					// screen entered
+	TRACE_LCD_BEGIN,				// TRACE_LCD_
+	TRACE_LCD_END,					// TRACE_LCD_
+	TRACE_EEPROM,					// TRACE_EE_ writer, one per byte written or updated
+	TRACE_VALVE_ON,					// 0
+	TRACE_VALVE_OFF,				// 0
+	TRACE_WATER_BEGIN,				// zone mask, first 8 zones
+	TRACE_WATER_END					// ZONE_EV_ reason
+};
+
+#define TRACE_LCD_SCREEN 0			// cleared and drawn on entry
+#define TRACE_LCD_FIELDS 1			// fields repainted in place
+#define TRACE_LCD_SCROLL 2			// display shifted a column (viewport.h)
+
+#define TRACE_EE_PROFILE 0
+#define TRACE_EE_CALIB   1
+#define TRACE_EE_HISTORY 2
+
+typedef struct TraceRec {
+	unsigned short time;
+	unsigned char type;
+	unsigned char arg;
+} TraceRec;
+
+TraceRec traceRing[TRACE_SIZE];
+unsigned char traceHead;			// next record to write, free running
+unsigned char traceHeld;			// set while a dump reads the ring
+unsigned char traceDumpAt;			// oldest record of the dump under way
+unsigned char traceDumpNext;		// records of it sent
+
+extern unsigned short tasksMs;		// scheduler.h
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Records one event; safe from tasks and ISRs
+//Parameter: TRACE_ event type and its argument
+//Returns: None
+ALWAYS_INLINE void Trace(unsigned char type, unsigned char arg)
+{
+#if TRACE_ENABLE
+	TraceRec* r;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (!traceHeld) {
+			r = &traceRing[traceHead++ & (TRACE_SIZE - 1)];
+			r->time = (tasksMs << 7) | (unsigned char)TCNT1;
+			r->type = type;
+			r->arg = arg;
+		}
+	}
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts sending the ring in binary on the console USART;
+//				  Trace_DumpStep() sends it, and events that happen meanwhile
+//				  are not recorded
+//Parameter: None
+//Returns: None
+void Trace_DumpStart()
+{
+	traceHeld = 1;
+	traceDumpAt = traceHead;
+	traceDumpNext = 0;
+	USART_Send('T', CONSOLE_USART);
+	USART_Send('R', CONSOLE_USART);
+	USART_Send('C', CONSOLE_USART);
+	USART_Send(TRACE_SIZE, CONSOLE_USART);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Sends the next TRACE_DUMP_RECS records of a dump; call once
+//				  per task tick
+//Parameter: None
+//Returns: 1 while the dump goes on, 0 once it is done or if none was started
+unsigned char Trace_DumpStep()
+{
+	const unsigned char* p;
+	unsigned char i, j;
+
+	if (!traceHeld) { return 0; }
+	for (i = 0; i < TRACE_DUMP_RECS; ++i) {
+		p = (const unsigned char*)&traceRing[(unsigned char)(traceDumpAt + traceDumpNext) & (TRACE_SIZE - 1)];
+		for (j = 0; j < sizeof(TraceRec); ++j) { USART_Send(p[j], CONSOLE_USART); }
+		if (++traceDumpNext == TRACE_SIZE) {
+			traceHeld = 0;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#endif //TRACE_H
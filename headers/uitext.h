@@ -0,0 +1,64 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// All UI text lives in flash. Strings are drawn straight from program memory
+// with LCD_DisplayString_P(); nothing here is copied into .data at startup.
+
+#ifndef UITEXT_H
+#define UITEXT_H
+
+#include <avr/pgmspace.h>
+
+const char txtWelcome[]    PROGMEM = "   Welcome To   <Leaf of Faith> ";
+const char txtBlank[]      PROGMEM = " ";
+const char txtYes[]        PROGMEM = "Yes";
+const char txtNo[]         PROGMEM = "No";
+const char txtNoPad[]      PROGMEM = "No ";
+
+// Menus
+const char txtMenuSet[]    PROGMEM = "> Set  Profile    Load Profile";
+const char txtMenuLoad[]   PROGMEM = "  Set  Profile  > Load Profile";
+const char txtMenuData[]   PROGMEM = "> Current Data    At A Glance";
+const char txtMenuGlance[] PROGMEM = "  Current Data  > At A Glance";
+const char txtMenuCalMS[]  PROGMEM = "> Calibrate MS    Calibrate Sun";
+const char txtMenuCalSun[] PROGMEM = "  Calibrate MS  > Calibrate Sun";
+const char txtMenuCurve[]  PROGMEM = "> Sensor Curves   Diagnostics";
+const char txtMenuDiag[]   PROGMEM = "  Sensor Curves > Diagnostics";
+const char txtScaler[]     PROGMEM = "Enable Scaler?";
+const char txtYay[]        PROGMEM = "< Yay >";
+const char txtNay[]        PROGMEM = "< Nay >";
+
+// Readings
+const char txtGlance1[]    PROGMEM = "Daytime h2O:    Frequency:";
+const char txtGlance2[]    PROGMEM = "MS:             SL:";
+const char txtDiag[]       PROGMEM = "Stack peak:     Free SRAM:";
+
+// Calibration and profile questions
+const char txtPlaceMS1[]   PROGMEM = "1.Place Moisture  Sensor    -->";
+const char txtSetPhoto1[]  PROGMEM = "1.Set Photo       Sensor    -->";
+const char txtSetPhoto3[]  PROGMEM = "3.Set Photo       Sensor    -->";
+const char txtCalib2[]     PROGMEM = "2.Reading:              SAVE -->";
+const char txtCalib4[]     PROGMEM = "4.Reading:              SAVE -->";
+const char txtSaving[]     PROGMEM = "Saving Profile..";
+const char txtCurveFor[]   PROGMEM = "Curve for:";
+const char txtCurveMS[]    PROGMEM = "< Moisture >";
+const char txtCurveSun[]   PROGMEM = "< Sunlight >";
+const char txtCurvePoint[] PROGMEM = "Raw:      Pt:   Ref %:     A=add";
+const char txtSavingCurve[] PROGMEM = "Saving Curve..";
+const char txtSourceSlot[] PROGMEM = "Source memory slot (1-4)?";
+const char txtSelectSlot[] PROGMEM = "Target memory slot (1-4)?";
+
+// Stored profile
+const char txtWaterDay[]   PROGMEM = "Water During Day";
+const char txtWaterEvery[] PROGMEM = "Water every     days";
+const char txtMSThresh[]   PROGMEM = "MS Threshold";
+const char txtSunThresh[]  PROGMEM = "Sun Threshold";
+const char txtPulseLen[]   PROGMEM = "Pulse length";
+
+const char txtQ1[]         PROGMEM = "OK to water during the day?";
+const char txtQ2[]         PROGMEM = "# of days between waterings?";
+const char txtQPulse[]     PROGMEM = "Pulse length?   x100 ms:";
+
+#endif //UITEXT_H
@@ -0,0 +1,87 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Field update hand-off to the serial bootloader (boot/bootloader.c), which
+// sits in the boot section and runs first on every reset (BOOTRST fuse). The
+// application asks for an update when the console receives UPDATE_WORD, by
+// storing UPDATE_REQUEST in one EEPROM byte and letting the watchdog reset
+// the part. Should no UPDATE_SYNC follow within a few seconds, the bootloader
+// clears the byte and goes back to the application. On the first
+// UPDATE_SYNC it stores UPDATE_FLASHING instead, also for an upload started
+// after a reset pin reset, and clears the byte only once a whole image has
+// been programmed, so an update cut short by a power loss starts over on the
+// next boot.
+//
+// Protocol, on the console USART at UPDATE_BAUD (U2X, exact at 8 MHz):
+//   frame  UPDATE_SOF <cmd> <arg lo> <arg hi> [SPM_PAGESIZE data] <crc lo> <crc hi>
+//          CRC-16/XMODEM over cmd, arg and data; data only with UPDATE_PAGE
+//   UPDATE_SYNC  arg 0; answer UPDATE_ACK and the application size in pages
+//   UPDATE_PAGE  arg = page number, from 0 in order (the last one may come
+//                again); programs and verifies one page
+//   UPDATE_END   arg = pages sent; starts the new application
+// Every frame is answered by one byte: UPDATE_ACK, UPDATE_NAK (bad CRC, send
+// again) or UPDATE_FAIL (flash did not verify or page out of range or order;
+// start over). A page is acknowledged as soon as it is received, while the previous
+// one is still being written, so the link and the flash overlap.
+//
+// EEPROM layout
+//   addr UPDATE_EE_REQUEST, free between the sensor curves and the history
+
+#ifndef UPDATE_H
+#define UPDATE_H
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include <avr/pgmspace.h>
+
+// Update Setup Values
+#define UPDATE_EE_REQUEST ((unsigned char*)127)
+#define UPDATE_REQUEST 0xB0			// asked for by the application
+#define UPDATE_FLASHING 0xB1			// upload begun, the application is not whole
+#define UPDATE_BAUD    500000UL
+
+#define UPDATE_SOF  0xA5
+#define UPDATE_SYNC 'S'
+#define UPDATE_PAGE 'P'
+#define UPDATE_END  'E'
+#define UPDATE_ACK  0x06
+#define UPDATE_NAK  0x15
+#define UPDATE_FAIL 'F'
+
+// Console word that asks for an update; none of its letters is a console
+// command of its own
+const char updateWord[] PROGMEM = "UPGRADE";
+unsigned char updateMatched;			// characters of updateWord received in a row
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Follows the console input for updateWord
+//Parameter: The byte received
+//Returns: 1 once the whole word was received, else 0
+unsigned char Update_Match(unsigned char c)
+{
+	if (c != pgm_read_byte(&updateWord[updateMatched])) { updateMatched = 0; }
+	if (c == pgm_read_byte(&updateWord[updateMatched])) { ++updateMatched; }
+	if (updateMatched < sizeof(updateWord) - 1) { return 0; }
+	updateMatched = 0;
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// **** WARNING: THIS FUNCTION DOES NOT RETURN ****
+//Functionality - Flags an update for the bootloader and resets the part
+//Parameter: None
+//Returns: None
+void Update_Request()
+{
+	eeprom_write_byte(UPDATE_EE_REQUEST, UPDATE_REQUEST);
+	eeprom_busy_wait();				// a reset mid-write could lose the byte
+	cli();
+	wdt_enable(WDTO_15MS);
+	for (;;) { asm("nop"); }		// until the watchdog bites
+}
+
+#endif //UPDATE_H
@@ -6,8 +6,13 @@
 #ifndef USART_1284_H
 #define USART_1284_H
 
-// USART Setup Values
-#define F_CPU 8000000UL // Assume uC operates at 8MHz
+#include "board.h"
+#include "bit.h"
+
+// USART Setup Values (F_CPU in board.h)
+// Every function is forced inline: the USART number is a constant at each
+// call site, so the usartNum branch folds away and only the register access
+// of the selected USART is emitted.
 #define BAUD_RATE 9600
 #define BAUD_PRESCALE (((F_CPU / (BAUD_RATE * 16UL))) - 1)
 
@@ -16,7 +21,7 @@
 //Parameter: usartNum specifies which USART is being initialized
 //			 If usartNum != 1, default to USART0
 //Returns: None
-void initUSART(unsigned char usartNum)
+ALWAYS_INLINE void initUSART(unsigned char usartNum)
 {
 	if (usartNum != 1) {
 		// Turn on the reception circuitry of USART0
@@ -45,7 +50,7 @@ void initUSART(unsigned char usartNum)
 //Functionality - checks if USART is ready to send
 //Parameter: usartNum specifies which USART is checked
 //Returns: 1 if true else 0
-unsigned char USART_IsSendReady(unsigned char usartNum)
+ALWAYS_INLINE unsigned char USART_IsSendReady(unsigned char usartNum)
 {
 	return (usartNum != 1) ? (UCSR0A & (1 << UDRE0)) : (UCSR1A & (1 << UDRE1));
 }
@@ -53,7 +58,7 @@ unsigned char USART_IsSendReady(unsigned char usartNum)
 //Functionality - checks if USART has successfully transmitted data
 //Parameter: usartNum specifies which USART is being checked
 //Returns: 1 if true else 0
-unsigned char USART_HasTransmitted(unsigned char usartNum)
+ALWAYS_INLINE unsigned char USART_HasTransmitted(unsigned char usartNum)
 {
 	return (usartNum != 1) ? (UCSR0A & (1 << TXC0)) : (UCSR1A & (1 << TXC1));
 }
@@ -62,7 +67,7 @@ unsigned char USART_HasTransmitted(unsigned char usartNum)
 //Functionality - checks if USART has recieved data
 //Parameter: usartNum specifies which USART is checked
 //Returns: 1 if true else 0
-unsigned char USART_HasReceived(unsigned char usartNum)
+ALWAYS_INLINE unsigned char USART_HasReceived(unsigned char usartNum)
 {
 	return (usartNum != 1) ? (UCSR0A & (1 << RXC0)) : (UCSR1A & (1 << RXC1));
 }
@@ -70,7 +75,7 @@ unsigned char USART_HasReceived(unsigned char usartNum)
 //Functionality - Flushes the data register
 //Parameter: usartNum specifies which USART is flushed
 //Returns: None
-void USART_Flush(unsigned char usartNum)
+ALWAYS_INLINE void USART_Flush(unsigned char usartNum)
 {
 	static unsigned char dummy;
 	if (usartNum != 1) {
@@ -86,7 +91,7 @@ void USART_Flush(unsigned char usartNum)
 //Parameter: Takes a single unsigned char value
 //			 usartNum specifies which USART will send the char
 //Returns: None
-void USART_Send(unsigned char sendMe, unsigned char usartNum)
+ALWAYS_INLINE void USART_Send(unsigned char sendMe, unsigned char usartNum)
 {
 	if (usartNum != 1) {
 		while( !(UCSR0A & (1 << UDRE0)) );
@@ -102,7 +107,7 @@ void USART_Send(unsigned char sendMe, unsigned char usartNum)
 //Functionality - receives an 8-bit char value
 //Parameter: usartNum specifies which USART is waiting to receive data
 //Returns: Unsigned char data from the receive buffer
-unsigned char USART_Receive(unsigned char usartNum)
+ALWAYS_INLINE unsigned char USART_Receive(unsigned char usartNum)
 {
 	if (usartNum != 1) {
 		while ( !(UCSR0A & (1 << RXC0)) ); // Wait for data to be received
@@ -114,7 +119,7 @@ unsigned char USART_Receive(unsigned char usartNum)
 	}
 }
 
-#endif USART_1284_H
+#endif //USART_1284_H
 
 //unsigned char GetBit(unsigned char x, unsigned char k) {
 	//return ((x & (0x01 << k)) != 0);
@@ -0,0 +1,95 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Valve drive on OC1A. Timer1 is the scheduler's time base in fast PWM mode
+// with TOP = ICR1 (one period per 1 ms tick), which leaves OCR1A free as the
+// duty cycle of the valve drive pin. The zone valves (zones.h) pick which
+// zone gets water, and this pin times how long it flows.
+//
+// Valve_Pulse() switches the drive fully on for VALVE_PULLIN_MS so the
+// solenoid pulls in. The drive then drops to VALVE_HOLD_DUTY percent to
+// hold it at lower current. Valve_Tick() counts the pulse down at the start
+// of every 1 ms tick and disconnects the pin when it ends. Tasks run with
+// interrupts enabled (scheduler.h), so the end of a pulse moves by at most
+// the entry latency of the tick, however long the tasks take.
+
+#ifndef VALVE_H
+#define VALVE_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "board.h"
+#include "bit.h"
+#include "trace.h"
+
+// Valve Setup Values (override in board.h or with -D)
+#ifndef VALVE_PULLIN_MS
+#define VALVE_PULLIN_MS 50			// full drive at the start of each pulse
+#endif
+#ifndef VALVE_HOLD_DUTY
+#define VALVE_HOLD_DUTY 50			// percent once pulled in, 100 for plain DC
+#endif
+
+unsigned short valveMs;				// ms left in the running pulse, 0 = closed
+unsigned char valvePullIn;			// ms of full drive left
+unsigned long valveOpenMs;			// total drive time since boot
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Makes the drive pin an output, low while no pulse runs
+//Parameter: None
+//Returns: None
+void Valve_Init()
+{
+	CLR_BIT(VALVE_DRIVE_PORT, VALVE_DRIVE_BIT);
+	SET_BIT(VALVE_DRIVE_DDR, VALVE_DRIVE_BIT);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts a timed pulse on the drive pin, replacing any pulse
+//				  still running
+//Parameter: Pulse length in ms (0 stops the drive)
+//Returns: None
+void Valve_Pulse(unsigned short ms)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (ms) { Trace(TRACE_VALVE_ON, 0); }
+		else if (valveMs) { Trace(TRACE_VALVE_OFF, 0); }
+		valveMs = ms;
+		valvePullIn = VALVE_PULLIN_MS;
+		OCR1A = ICR1;				// OCR1A == TOP: constantly high
+		if (ms) { SET_BIT(TCCR1A, COM1A1); } else { CLR_BIT(TCCR1A, COM1A1); }
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Checks whether a pulse is still running
+//Parameter: None
+//Returns: 1 while the drive is on else 0
+unsigned char Valve_Busy()
+{
+	unsigned char busy;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { busy = (valveMs != 0); }
+	return busy;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Counts the running pulse down; call first in the 1 ms tick
+//Parameter: None
+//Returns: None
+ALWAYS_INLINE void Valve_Tick()
+{
+	if (!valveMs) { return; }
+	++valveOpenMs;
+	if (--valveMs == 0) {
+		CLR_BIT(TCCR1A, COM1A1);	// pin back to PORT, which is low
+		Trace(TRACE_VALVE_OFF, 0);
+		return;
+	}
+	if (valvePullIn && --valvePullIn == 0) {
+		OCR1A = (unsigned short)((unsigned long)ICR1 * VALVE_HOLD_DUTY / 100);
+	}
+}
+
+#endif //VALVE_H
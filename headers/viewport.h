@@ -0,0 +1,87 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Text viewport for prompts longer than the 16 visible columns. Each line of
+// the LCD's DDRAM is 40 characters wide, so the prompt is written once along
+// the first line and brought into view by shifting the display: a scroll
+// step is one command instead of sixteen data writes. The prompt rests at
+// its start, scrolls to its end one column per tick, rests and scrolls back.
+//
+// The shift moves both rows. A field on row 2 stays in view at every shift
+// when it lies within the columns past the prompt's length, i.e. from column
+// 17 + (length - 16) = length + 1 on.
+
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+#include <avr/pgmspace.h>
+#include "io.h"
+#include "trace.h"
+
+// Viewport Setup Values
+#define VIEW_COLUMNS 16
+#define VIEW_LINE 40				// characters per DDRAM line
+#define VIEW_HOLD 5					// ticks resting at either end
+
+unsigned char viewMax;				// furthest shift, 0 when nothing scrolls
+unsigned char viewShift;
+signed char viewDir;				// +1 scrolling on, -1 back
+unsigned char viewWait;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Forgets the prompt; call when the screen was cleared, which
+//				  also takes the display back to no shift
+//Parameter: None
+//Returns: None
+void View_Reset()
+{
+	viewMax = 0;
+	viewShift = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Writes a prompt along the first DDRAM line, from column 1
+//				  and without wrapping to row 2, and scrolls it when it does
+//				  not fit; call on a cleared screen
+//Parameter: The flash string, up to 40 characters
+//Returns: None
+void View_Show_P(const char* text)
+{
+	unsigned char n = 0, ch;
+
+	LCD_Cursor(1);
+	while (n < VIEW_LINE && (ch = pgm_read_byte(text++))) {
+		LCD_WriteData(ch);
+		++n;
+	}
+	viewMax = (n > VIEW_COLUMNS) ? n - VIEW_COLUMNS : 0;
+	viewShift = 0;
+	viewDir = 1;
+	viewWait = VIEW_HOLD;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Runs one viewport tick: rests or shifts the display a column
+//Parameter: None
+//Returns: 1 while a prompt is scrolling, 0 otherwise
+unsigned char View_Step()
+{
+	if (!viewMax) { return 0; }
+	if (viewWait) {
+		--viewWait;
+		return 1;
+	}
+	viewShift += viewDir;
+	Trace(TRACE_LCD_BEGIN, TRACE_LCD_SCROLL);
+	LCD_Shift(viewShift);
+	Trace(TRACE_LCD_END, TRACE_LCD_SCROLL);
+	if (viewShift == 0 || viewShift == viewMax) {
+		viewDir = -viewDir;
+		viewWait = VIEW_HOLD;
+	}
+	return 1;
+}
+
+#endif //VIEWPORT_H
@@ -0,0 +1,131 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Watchdog supervised warm restart. The scheduler feeds the watchdog only
+// once every task has ticked in a round, so a task stuck in a spin loop
+// resets the part. At the end of each round the state that must survive is
+// copied into a .noinit block, which the C startup leaves untouched, and
+// sealed with a checksum. After a watchdog reset a block that checks out is
+// restored: zones keep their slots and interval timers, the UI comes back on
+// the same screen and the LCD, still configured, is not initialised again.
+
+#ifndef WARM_H
+#define WARM_H
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include "zones.h"
+#include "profile.h"
+
+// Warm Restart Setup Values
+#define WARM_MAGIC 0x5EED
+#ifndef WARM_WDTO
+#define WARM_WDTO  WDTO_2S			// longest round is the 1.2 s idle UI task
+#endif
+
+#define NOINIT __attribute__((section(".noinit")))
+
+typedef struct WarmState {
+	unsigned short magic;
+	unsigned char zoneSlot[NUM_ZONES];
+	unsigned char zoneFreq[NUM_ZONES];
+	unsigned short zoneMin[NUM_ZONES];
+	unsigned char zoneDays[NUM_ZONES];
+	unsigned char zoneTicks;
+	unsigned char zoneSec;
+	unsigned char screen;			// ss() state
+	unsigned char memSlot;			// active profile slot
+	unsigned char scaler;
+	unsigned char watered;
+	PlantProfile plant;				// profile being viewed or edited
+	unsigned short sum;				// Warm_Sum() of everything above
+} WarmState;
+
+WarmState warm NOINIT;
+unsigned char warmResetFlags NOINIT;	// MCUSR as found at reset
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Saves and clears the reset cause and stops the watchdog,
+//				  which stays on at its shortest timeout after a watchdog reset
+//				  Runs from .init3 on the part, ahead of the .data/.bss setup
+//Parameter: None
+//Returns: None
+#if defined(__AVR__)
+void Warm_Early(void) __attribute__((naked, used, section(".init3")));
+#endif
+void Warm_Early(void)
+{
+	warmResetFlags = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Fletcher style checksum of the block, excluding the sum
+//Parameter: None
+//Returns: The checksum
+unsigned short Warm_Sum()
+{
+	const unsigned char* p = (const unsigned char*)&warm;
+	unsigned char n = sizeof(warm) - sizeof(warm.sum);
+	unsigned char a = 0x5A;
+	unsigned char b = 0;
+
+	while (n--) {
+		a += *p++;
+		b += a;
+	}
+	return ((unsigned short)b << 8) | a;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Copies the zone clocks into the block and seals it; the
+//				  caller fills in the UI fields first
+//Parameter: None
+//Returns: None
+void Warm_Save()
+{
+	unsigned char z;
+	for (z = 0; z < NUM_ZONES; ++z) {
+		warm.zoneSlot[z] = zoneSlot[z];
+		warm.zoneFreq[z] = zoneFreq[z];
+		warm.zoneMin[z] = zoneMin[z];
+		warm.zoneDays[z] = zoneDays[z];
+	}
+	warm.zoneTicks = zoneTicks;
+	warm.zoneSec = zoneSec;
+	warm.magic = WARM_MAGIC;
+	warm.sum = Warm_Sum();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - After a watchdog reset, restores the zone slots and clocks
+//				  from a valid block; call before Zone_Init()
+//Parameter: None
+//Returns: 1 if the block was restored (the caller restores the UI fields),
+//		   0 for a cold boot
+unsigned char Warm_Restore()
+{
+	unsigned char z;
+
+#if !defined(__AVR__)
+	Warm_Early();					// the host build has no .init sections
+#endif
+	if (!(warmResetFlags & (1 << WDRF)) || warm.magic != WARM_MAGIC || warm.sum != Warm_Sum()) {
+		warm.magic = 0;
+		return 0;
+	}
+	for (z = 0; z < NUM_ZONES; ++z) {
+		zoneSlot[z] = warm.zoneSlot[z];
+		zoneFreq[z] = warm.zoneFreq[z];
+		zoneMin[z] = warm.zoneMin[z];
+		zoneDays[z] = warm.zoneDays[z];
+	}
+	zoneTicks = warm.zoneTicks;
+	zoneSec = warm.zoneSec;
+	return 1;
+}
+
+#endif //WARM_H
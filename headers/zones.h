@@ -0,0 +1,384 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Multi-zone watering. Every zone has its own profile, ADC channel mapping,
+// interval timer and valve output. State is kept structure-of-arrays so
+// Zone_Tick() can evaluate the watering condition for every zone in a single
+// tight loop, and all valves are driven by one masked port write per tick.
+// The water itself is timed by the drive pulse (valve.h): a zone valve opens
+// when a watering starts and closes on the first tick after it ends. Zones
+// that come due on the same tick share one watering and the longest pulse
+// they ask for; zones that come due while one runs wait for it.
+//
+// Closed loop (ZONE_CLOSED_LOOP): a watering is pulse, soak, re-measure,
+// repeated until the moisture of every zone in it reaches its threshold or
+// ZONE_MAX_WATER_MS of water has gone out. Readings are compared with the
+// thresholds in calibrated units (calib.h). Zone_Control() runs from the 1 ms
+// tick: it samples the moisture probes every ms through a low-pass filter
+// and cuts a pulse short as soon as the filtered readings cross the target.
+// With ZONE_CLOSED_LOOP 0 a watering is a single pulse. The end of every
+// watering is reported to the tasks on zoneEvents.
+//
+// The sensors are sampled by the 1 ms tick (Zone_Sample()) into adcShared,
+// guarded by a seqlock; tasks work from the copy Zone_Snapshot() takes.
+//
+// A zone is idle until it is bound to a profile slot with Zone_Bind().
+// Zone 0 is the zone edited from the menus.
+
+#ifndef ZONES_H
+#define ZONES_H
+
+#include <util/atomic.h>
+#include "board.h"
+#include "profile.h"
+#include "valve.h"
+#include "adc.h"
+#include "sensor.h"
+#include "sync.h"
+#include "calib.h"
+#include "trace.h"
+
+// Zone Setup Values (override before including for a bench build)
+#ifndef NUM_ZONES
+#define NUM_ZONES 1
+#endif
+
+#ifndef ZONE_MS_CHANNELS
+#define ZONE_MS_CHANNELS  { 6 }		// ADC channel of each zone's moisture probe
+#endif
+#ifndef ZONE_SUN_CHANNELS
+#define ZONE_SUN_CHANNELS { 7 }		// ADC channel of each zone's light sensor
+#endif
+#ifndef ZONE_VALVE_BITS
+#define ZONE_VALVE_BITS   { 1 }		// bit 0-7: VALVE_PORT_LO, bit 8-15: VALVE_PORT_HI
+#endif
+#ifndef ZONE_BOOT_SLOTS
+#define ZONE_BOOT_SLOTS   { 0 }		// profile slot bound at boot, 0 = unbound
+#endif
+
+// Closed-loop Setup Values
+#ifndef ZONE_CLOSED_LOOP
+#define ZONE_CLOSED_LOOP 1
+#endif
+#ifndef ZONE_SOAK_MS
+#define ZONE_SOAK_MS 3000			// wait after a pulse before judging the reading
+#endif
+#ifndef ZONE_MAX_WATER_MS
+#define ZONE_MAX_WATER_MS 60000		// safety limit on the water in one watering
+#endif
+#define ZONE_FILTER_SHIFT 4			// 1 kHz first-order low-pass, ~16 ms
+
+// Events on zoneEvents, arg: ms of water let out
+#define ZONE_EV_DONE  1					// reached the moisture target, or the open-loop pulse ended
+#define ZONE_EV_LIMIT 2					// stopped at ZONE_MAX_WATER_MS short of the target
+
+#if NUM_ZONES > 16
+#error "NUM_ZONES: the valve mask is 16 bits wide"
+#endif
+
+#define ZONE_DEMO_FREQ 99			// frequency keyed as '*': water every minute
+#define ZONE_MIN_PER_DAY 1440
+#define ZONE_BIT(z) ((zonemask_t)1 << (z))
+
+typedef unsigned short zonemask_t;
+
+// Zone configuration
+const unsigned char zoneMsChannel[NUM_ZONES]  = ZONE_MS_CHANNELS;
+const unsigned char zoneSunChannel[NUM_ZONES] = ZONE_SUN_CHANNELS;
+const unsigned char zoneValveBit[NUM_ZONES]   = ZONE_VALVE_BITS;
+unsigned char zoneSlot[NUM_ZONES]             = ZONE_BOOT_SLOTS;
+
+// Zone profiles
+zonemask_t zoneEnabled;
+zonemask_t zoneDayOK;
+unsigned char zoneFrequency[NUM_ZONES];
+unsigned short zoneMoisture[NUM_ZONES];
+unsigned short zoneSunLevel[NUM_ZONES];
+unsigned short zoneWaterMs[NUM_ZONES];
+
+// Zone timers
+unsigned char zoneFreq[NUM_ZONES];			// frequency the running interval was started with
+unsigned short zoneMin[NUM_ZONES];			// minutes into the current day of the interval
+unsigned char zoneDays[NUM_ZONES];			// whole days since the last watering
+
+// Closed-loop controller, run from the 1 ms tick
+enum { ZONE_CTL_IDLE, ZONE_CTL_PULSE, ZONE_CTL_SOAK };
+volatile unsigned char zoneCtl;
+zonemask_t zoneCtlZones;					// zones in the running watering
+unsigned short zoneCtlPulse;				// length of each pulse, ms
+unsigned short zoneCtlWater;				// water let out so far, ms
+unsigned short zoneCtlWait;					// ms left in the soak
+unsigned short zoneFilt[NUM_ZONES];			// filtered moisture << ZONE_FILTER_SHIFT
+EventQueue zoneEvents;						// tick -> task: ZONE_EV_ records
+
+// Outputs and shared sensor state
+zonemask_t zoneWatering;					// zones whose valve is open
+zonemask_t valvePins;						// physical valve bits owned by the zones
+unsigned char adcChannels;					// ADC channels referenced by any zone
+unsigned short adcShared[8];				// latest raw reading per ADC channel, written by the tick
+SeqLock adcSeq;								// guards adcShared
+unsigned short adcValue[8];					// the tasks' copy of adcShared
+
+// Wall clock shared by all zones
+unsigned char zoneTicks;					// 100 ms ticks
+unsigned char zoneSec;
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Drives every zone valve with one write per port
+//Parameter: Physical valve bits to open, all other valve bits are closed
+//Returns: None
+void Valve_Write(zonemask_t open)
+{
+	// the tick sets the sensor supply on the same port
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		VALVE_PORT_LO = (VALVE_PORT_LO & ~(unsigned char)valvePins) | ((unsigned char)open & (unsigned char)valvePins);
+#ifdef VALVE_PORT_HI
+		VALVE_PORT_HI = (VALVE_PORT_HI & ~(unsigned char)(valvePins >> 8)) | ((unsigned char)(open >> 8) & (unsigned char)(valvePins >> 8));
+#endif
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Copies a profile into a zone; Zone_Tick() restarts the
+//				  interval when the frequency changed
+//Parameter: The zone number and the profile to water it by
+//Returns: None
+void Zone_SetProfile(unsigned char z, const PlantProfile* p)
+{
+	zoneDayOK = p->dayTimeWaterOK ? (zoneDayOK | ZONE_BIT(z)) : (zoneDayOK & ~ZONE_BIT(z));
+	zoneFrequency[z] = p->waterFrequency;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { zoneMoisture[z] = p->moisture; }	// read by the tick
+	zoneSunLevel[z] = p->sunLevel;
+	zoneWaterMs[z] = Profile_WaterMs(p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Binds a zone to a profile slot and enables it
+//Parameter: The zone number and the slot 1..PROFILE_SLOTS (0 disables the zone)
+//Returns: None
+void Zone_Bind(unsigned char z, unsigned char slot)
+{
+	zoneSlot[z] = slot;
+	if (!Profile_IsSlot(slot)) {
+		zoneEnabled &= ~ZONE_BIT(z);
+		return;
+	}
+	Zone_SetProfile(z, Profile_Get(slot));
+	zoneEnabled |= ZONE_BIT(z);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Reloads every zone bound to a slot after the slot was saved
+//Parameter: The slot 1..PROFILE_SLOTS that changed
+//Returns: None
+void Zone_Refresh(unsigned char slot)
+{
+	unsigned char z;
+	for (z = 0; z < NUM_ZONES; ++z) {
+		if (zoneSlot[z] == slot) { Zone_Bind(z, slot); }
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Builds the channel and valve masks and binds the boot slots
+//Parameter: None
+//Returns: None
+void Zone_Init()
+{
+	unsigned char z;
+	adcChannels = 0;
+	valvePins = 0;
+	for (z = 0; z < NUM_ZONES; ++z) {
+		adcChannels |= (1 << zoneMsChannel[z]) | (1 << zoneSunChannel[z]);
+		valvePins |= ZONE_BIT(zoneValveBit[z]);
+		Zone_Bind(z, zoneSlot[z]);
+	}
+	Valve_Write(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Samples every ADC channel used by a zone, once per channel,
+//				  with the sensors powered only while it does; call from the
+//				  tick, or before the tasks start
+//Parameter: None
+//Returns: None
+void Zone_Sample()
+{
+	unsigned char ch;
+	Sensor_On();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {	// keeps the boot sample from racing the tick's
+		Seq_WriteBegin(&adcSeq);
+		for (ch = 0; ch < 8; ++ch) {
+			if (adcChannels & (1 << ch)) { adcShared[ch] = ADC_Read(ch); }
+		}
+		Seq_WriteEnd(&adcSeq);
+	}
+	Sensor_Off();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Copies the tick's latest sample into adcValue without
+//				  blocking the tick; call from a task
+//Parameter: None
+//Returns: None
+void Zone_Snapshot()
+{
+	unsigned char ch, s;
+	do {
+		s = Seq_ReadBegin(&adcSeq);
+		for (ch = 0; ch < 8; ++ch) { adcValue[ch] = adcShared[ch]; }
+	} while (Seq_ReadRetry(&adcSeq, s));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Starts a watering: the first pulse, and under closed loop
+//				  the filters, seeded with the last 100 ms samples
+//Parameter: Mask of zones to water and the pulse length in ms
+//Returns: None
+void Zone_StartWatering(zonemask_t zones, unsigned short pulse)
+{
+	unsigned char z;
+	for (z = 0; z < NUM_ZONES; ++z) {
+		zoneFilt[z] = adcValue[zoneMsChannel[z]] << ZONE_FILTER_SHIFT;
+	}
+	if (pulse > ZONE_MAX_WATER_MS) { pulse = ZONE_MAX_WATER_MS; }
+	Sensor_Hold(ZONE_CLOSED_LOOP);
+	Trace(TRACE_WATER_BEGIN, (unsigned char)zones);
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		zoneCtlZones = zones;
+		zoneCtlPulse = pulse;
+		zoneCtlWater = pulse;
+		zoneCtl = ZONE_CTL_PULSE;
+		Valve_Pulse(pulse);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Runs the watering controller; call every 1 ms
+//Parameter: None
+//Returns: None
+void Zone_Control()
+{
+#if ZONE_CLOSED_LOOP
+	unsigned char z;
+	zonemask_t bit;
+	zonemask_t wet = 0;
+#endif
+	unsigned short pulse;
+
+	if (zoneCtl == ZONE_CTL_IDLE) { return; }
+
+#if ZONE_CLOSED_LOOP
+	for (z = 0, bit = 1; z < NUM_ZONES; ++z, bit <<= 1) {
+		if (!(zoneCtlZones & bit)) { continue; }
+		zoneFilt[z] += ADC_Read(zoneMsChannel[z]) - (zoneFilt[z] >> ZONE_FILTER_SHIFT);
+		if (Cal_Apply(CAL_MS, zoneFilt[z] >> ZONE_FILTER_SHIFT) >= zoneMoisture[z]) { wet |= bit; }
+	}
+	if (wet == zoneCtlZones) {		// at target, even part way into a pulse
+		zoneCtlWater -= valveMs;
+		Valve_Pulse(0);
+		zoneCtl = ZONE_CTL_IDLE;
+		Sensor_Hold(0);
+		Trace(TRACE_WATER_END, ZONE_EV_DONE);
+		Queue_Put(&zoneEvents, ZONE_EV_DONE, zoneCtlWater);
+		return;
+	}
+#endif
+
+	if (zoneCtl == ZONE_CTL_PULSE) {
+		if (valveMs) { return; }
+		zoneCtlWait = ZONE_SOAK_MS;
+#if ZONE_CLOSED_LOOP
+		zoneCtl = ZONE_CTL_SOAK;
+#else
+		zoneCtl = ZONE_CTL_IDLE;
+		Trace(TRACE_WATER_END, ZONE_EV_DONE);
+		Queue_Put(&zoneEvents, ZONE_EV_DONE, zoneCtlWater);
+#endif
+		return;
+	}
+
+	if (--zoneCtlWait) { return; }
+	if (zoneCtlWater >= ZONE_MAX_WATER_MS) {
+		zoneCtl = ZONE_CTL_IDLE;
+		Sensor_Hold(0);
+		Trace(TRACE_WATER_END, ZONE_EV_LIMIT);
+		Queue_Put(&zoneEvents, ZONE_EV_LIMIT, zoneCtlWater);
+		return;
+	}
+	pulse = ZONE_MAX_WATER_MS - zoneCtlWater;
+	if (pulse > zoneCtlPulse) { pulse = zoneCtlPulse; }
+	zoneCtlWater += pulse;
+	zoneCtl = ZONE_CTL_PULSE;
+	Valve_Pulse(pulse);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Advances the zone clocks and evaluates every zone; call every 100 ms
+//Parameter: None
+//Returns: Mask of zones that started watering on this tick
+zonemask_t Zone_Tick()
+{
+	unsigned char z;
+	unsigned char minute = 0;
+	unsigned char busy = (zoneCtl != ZONE_CTL_IDLE);
+	unsigned short pulse = 0;
+	zonemask_t open = 0;
+	zonemask_t started = 0;
+	zonemask_t bit;
+
+	Zone_Snapshot();
+	if (++zoneTicks >= 10) {
+		zoneTicks = 0;
+		if (++zoneSec >= 60) {
+			zoneSec = 0;
+			minute = 1;
+		}
+	}
+
+	for (z = 0, bit = 1; z < NUM_ZONES; ++z, bit <<= 1) {
+		if (!(zoneEnabled & bit)) { continue; }
+
+		// the valve stays open while the watering runs
+		if ((zoneWatering & bit) && busy) {
+			open |= ZONE_BIT(zoneValveBit[z]);
+			continue;
+		}
+
+		// a valve whose watering is over closes now and the interval restarts;
+		// a changed frequency means the profile was switched, restart as well
+		if ((zoneWatering & bit) || zoneFreq[z] != zoneFrequency[z]) {
+			zoneWatering &= ~bit;
+			zoneFreq[z] = zoneFrequency[z];
+			zoneMin[z] = 0;
+			zoneDays[z] = 0;
+			continue;
+		}
+
+		if (minute && ++zoneMin[z] >= ZONE_MIN_PER_DAY) {
+			zoneMin[z] = 0;
+			++zoneDays[z];
+		}
+
+		if (busy) { continue; }
+		if ((zoneFreq[z] == ZONE_DEMO_FREQ) ? (zoneMin[z] >= 1) : (zoneDays[z] >= zoneFreq[z])) {
+			if (Cal_Apply(CAL_MS, adcValue[zoneMsChannel[z]]) < zoneMoisture[z]
+				&& ((zoneDayOK & bit) || Cal_Apply(CAL_SUN, adcValue[zoneSunChannel[z]]) < zoneSunLevel[z])) {
+				open |= ZONE_BIT(zoneValveBit[z]);
+				started |= bit;
+				if (zoneWaterMs[z] > pulse) { pulse = zoneWaterMs[z]; }
+			}
+		}
+	}
+
+	Valve_Write(open);
+	if (started) {
+		zoneWatering |= started;
+		Zone_StartWatering(started, pulse);
+	}
+	return started;
+}
+
+#endif //ZONES_H
@@ -0,0 +1,30 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host stand-in for <avr/eeprom.h>. Addresses index hal.c's EEPROM image.
+// A write keeps the EEPROM busy for 3.4 ms of virtual time, and the next
+// access waits for it, as on the part.
+
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EEMEM __attribute__((section(".eeprom")))
+
+uint8_t eeprom_read_byte(const uint8_t* addr);
+uint16_t eeprom_read_word(const uint16_t* addr);
+void eeprom_read_block(void* dst, const void* src, size_t n);
+void eeprom_write_byte(uint8_t* addr, uint8_t value);
+void eeprom_write_word(uint16_t* addr, uint16_t value);
+void eeprom_write_block(const void* src, void* dst, size_t n);
+void eeprom_update_byte(uint8_t* addr, uint8_t value);
+void eeprom_update_word(uint16_t* addr, uint16_t value);
+void eeprom_update_block(const void* src, void* dst, size_t n);
+int eeprom_is_ready(void);
+void eeprom_busy_wait(void);			// waits in virtual time, not in a spin
+
+#endif //HOST_AVR_EEPROM_H
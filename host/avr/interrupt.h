@@ -0,0 +1,24 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host stand-in for <avr/interrupt.h>. An ISR is an ordinary function that
+// hal.c dispatches when its source is pending, enabled and I is set in SREG.
+// ISR_NOBLOCK is honoured: hal_isr_enter() re-enables interrupts on entry.
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) \
+	static void vector##_body(void); \
+	void vector(void) { hal_isr_enter(#__VA_ARGS__); vector##_body(); } \
+	static void vector##_body(void)
+
+#define sei() hal_sei()
+#define cli() hal_cli()
+#define reti() return
+
+#endif //HOST_AVR_INTERRUPT_H
@@ -0,0 +1,218 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host stand-in for <avr/io.h> (ATmega1284 subset). See host/hal.h.
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+#include "hal.h"
+
+#ifndef __AVR_ATmega1284__
+#define __AVR_ATmega1284__ 1
+#endif
+
+#define _BV(bit) (1 << (bit))
+
+// asm("nop") is the only inline assembly the firmware uses; it costs time
+#define asm(x) hal_nop()
+
+// Memory map
+#define RAMSTART 0x0100
+#define RAMEND   0x40FF
+#define E2END    0x0FFF
+#define FLASHEND 0x1FFFF
+#define SPM_PAGESIZE 256
+
+// Plain registers
+extern volatile uint8_t PORTA, PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRA, DDRB, DDRC, DDRD;
+extern volatile uint8_t ADMUX, ADCSRB, DIDR0;
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1;
+extern volatile uint16_t OCR1A, OCR1B, ICR1;
+extern volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3;
+extern volatile uint16_t OCR3A, OCR3B, ICR3;
+extern volatile uint8_t SREG, MCUSR, MCUCR, SMCR, WDTCSR, GPIOR0, PRR0, SPMCSR;
+extern volatile uint8_t UCSR0B, UCSR0C, UBRR0L, UBRR0H;
+extern volatile uint8_t UCSR1B, UCSR1C, UBRR1L, UBRR1H;
+extern volatile uint8_t SPCR, SPSR, SPDR;
+extern volatile uint8_t SPL, SPH;
+
+// Registers backed by the simulated peripherals
+#define PINA   (hal_pin(0))
+#define PINB   (hal_pin(1))
+#define PINC   (hal_pin(2))
+#define PIND   (hal_pin(3))
+#define ADC    (hal_adc())
+#define ADCW   ADC
+#define ADCL   ((uint8_t)hal_adc())
+#define ADCH   ((uint8_t)(hal_adc() >> 8))
+#define ADCSRA (*hal_adcsra())
+#define UDR0   (*hal_udr(0))
+#define UDR1   (*hal_udr(1))
+#define UCSR0A (*hal_ucsra(0))
+#define UCSR1A (*hal_ucsra(1))
+#define TCNT1  (*hal_tcnt(1))
+#define TCNT3  (*hal_tcnt(3))
+#define TIFR1  (*hal_tifr(1))
+#define TIFR3  (*hal_tifr(3))
+#define UBRR0  (*(volatile uint16_t*)&UBRR0L)
+#define UBRR1  (*(volatile uint16_t*)&UBRR1L)
+
+// Pin numbers
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// ADC
+#define MUX0   0
+#define MUX1   1
+#define MUX2   2
+#define ADLAR  5
+#define REFS0  6
+#define REFS1  7
+#define ADPS0  0
+#define ADPS1  1
+#define ADPS2  2
+#define ADIE   3
+#define ADIF   4
+#define ADATE  5
+#define ADSC   6
+#define ADEN   7
+
+// Timers
+#define CS00   0
+#define CS01   1
+#define CS02   2
+#define WGM00  0
+#define WGM01  1
+#define OCIE0A 1
+#define WGM10  0
+#define WGM11  1
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10   0
+#define CS11   1
+#define CS12   2
+#define WGM12  3
+#define WGM13  4
+#define FOC1B  6
+#define FOC1A  7
+#define TOIE1  0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOV1   0
+#define OCF1A  1
+#define OCF1B  2
+#define WGM30  0
+#define WGM31  1
+#define COM3B0 4
+#define COM3B1 5
+#define COM3A0 6
+#define COM3A1 7
+#define CS30   0
+#define CS31   1
+#define CS32   2
+#define WGM32  3
+#define WGM33  4
+#define TOIE3  0
+#define OCIE3A 1
+#define OCIE3B 2
+#define TOV3   0
+#define OCF3A  1
+#define OCF3B  2
+
+// USART
+#define MPCM0  0
+#define U2X0   1
+#define UDRE0  5
+#define TXC0   6
+#define RXC0   7
+#define TXEN0  3
+#define RXEN0  4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCSZ00 1
+#define UCSZ01 2
+#define U2X1   1
+#define UDRE1  5
+#define TXC1   6
+#define RXC1   7
+#define TXEN1  3
+#define RXEN1  4
+#define UDRIE1 5
+#define TXCIE1 6
+#define RXCIE1 7
+#define UCSZ10 1
+#define UCSZ11 2
+
+// SPI
+#define SPR0   0
+#define SPR1   1
+#define CPHA   2
+#define CPOL   3
+#define MSTR   4
+#define DORD   5
+#define SPE    6
+#define SPIE   7
+#define SPI2X  0
+#define SPIF   7
+
+// System
+#define PORF   0
+#define EXTRF  1
+#define BORF   2
+#define WDRF   3
+#define WDP0   0
+#define WDP1   1
+#define WDP2   2
+#define WDE    3
+#define WDCE   4
+#define WDP3   5
+#define WDIE   6
+#define WDIF   7
+#define SE     0
+#define SM0    1
+#define SM1    2
+#define SM2    3
+#define IVCE   0
+#define IVSEL  1
+#define PUD    4
+
+#endif //HOST_AVR_IO_H
@@ -0,0 +1,21 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host stand-in for <avr/sleep.h>. sleep_mode() advances virtual time to the
+// next interrupt and dispatches it, which is what idle sleep does on the part.
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE 0
+#define set_sleep_mode(mode) (SMCR = (SMCR & ~0x0E) | ((mode) << SM0))
+#define sleep_enable() (SMCR |= (1 << SE))
+#define sleep_disable() (SMCR &= ~(1 << SE))
+#define sleep_cpu() hal_sleep()
+#define sleep_mode() hal_sleep()
+
+#endif //HOST_AVR_SLEEP_H
@@ -0,0 +1,30 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host stand-in for <avr/wdt.h>. hal.c keeps the watchdog deadline in virtual
+// time; if it passes, the run ends and the report counts the reset (the host
+// cannot restart the firmware with .noinit intact).
+
+#ifndef HOST_AVR_WDT_H
+#define HOST_AVR_WDT_H
+
+#include <avr/io.h>
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+#define WDTO_4S 8
+#define WDTO_8S 9
+
+#define wdt_enable(timeout) hal_wdt_enable(timeout)
+#define wdt_disable() hal_wdt_enable(-1)
+#define wdt_reset() hal_wdt_reset()
+
+#endif //HOST_AVR_WDT_H
@@ -0,0 +1,477 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Worst-case execution time explorer for the UI state machine. Boots the
+// firmware against hal.c like leaf_sim, then walks every screen it can reach:
+// at each UI tick it forks once per input (joystick centred or pushed one way,
+// or one keypad key held), lets the child run that one ss() call, and records
+// what the call cost in virtual time, LCD bus writes and EEPROM writes. A
+// child that lands in a context nobody has explored yet carries on from there
+// with the inputs released, so every reachable transition is measured once.
+//
+// A context is the screen plus the UI variables its ready checks look at
+// (gotit, memSlot, whether a curve has points), so screens behind a "press a
+// key first" gate are reached too. Costs include
+// the 1 ms tick and any interrupt served while ss() ran, as on the part.
+//
+//   leaf_explore [-n 10] [-p 300] [-e eeprom.bin] [-w worst.txt] [-c worst.txt]
+//
+//   -n  how many of the most expensive transitions to list, with their paths
+//   -p  the UI period in ms; transitions longer than this are flagged
+//   -e  EEPROM image to boot from (default blank, as from the factory)
+//   -w  write each screen's worst case to a file
+//   -c  compare each screen's worst case against a file written by -w,
+//       typically by the build of another commit
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "hal.h"
+
+#define EXPLORE_NODES 4096				// contexts
+#define EXPLORE_TRANS (EXPLORE_NODES * 21)
+#define EXPLORE_DEPTH 256				// transitions from the first screen
+#define EXPLORE_STATES 256
+#define EXPLORE_TIMEOUT_MS 10000		// a child that reaches no UI tick by then is dropped
+#define EXPLORE_CENTER 512
+#define EXPLORE_MS_CH 6
+#define EXPLORE_SUN_CH 7
+
+// Firmware side, main.c. Built with -fshort-enums and -fpack-struct, so the
+// state enum is one byte and these mirror the packed layouts.
+typedef struct __attribute__((packed)) ExploreTask {
+	signed char state;
+	unsigned long period;
+	unsigned long elapsedTime;
+	int (*TickFct)(int);
+} ExploreTask;
+
+typedef struct __attribute__((packed)) ExploreCurve {
+	unsigned char n;
+	unsigned short raw[6];
+	unsigned short val[6];
+} ExploreCurve;
+
+int firmware_main(void);
+extern ExploreTask* uiTask;
+extern unsigned char stater;
+extern unsigned char gotit;
+extern unsigned char memSlot;
+extern ExploreCurve curve;
+extern unsigned short LR;
+extern unsigned short UD;
+
+typedef struct ExploreKey {
+	unsigned char stater, gotit, memSlot, curveN;
+} ExploreKey;
+
+typedef struct ExploreNode {
+	ExploreKey key;
+	int via;							// transition that first reached it, -1 at the root
+	unsigned short depth;				// transitions on the shortest way there found
+	char screen[17];					// top row of the display
+} ExploreNode;
+
+typedef struct ExploreTrans {
+	int from;							// node
+	unsigned char input;
+	unsigned char to;					// stater after the call
+	uint64_t cycles;
+	uint32_t lcdOps;
+	uint32_t eeWrites;
+	char screen[17];					// top row once the call returned
+} ExploreTrans;
+
+// Shared by every process; only one runs at a time, as each parent waits
+typedef struct ExploreShared {
+	int nodes;
+	int trans;
+	int dropped;						// children that timed out or hit a limit
+	ExploreNode node[EXPLORE_NODES];
+	ExploreTrans tran[EXPLORE_TRANS];
+} ExploreShared;
+
+static const char* const exploreInputs[] = {
+	"none", "up", "down", "left", "right",
+	"key 0", "key 1", "key 2", "key 3", "key 4", "key 5", "key 6", "key 7",
+	"key 8", "key 9", "key A", "key B", "key C", "key D", "key *", "key #"
+};
+#define EXPLORE_INPUTS (sizeof(exploreInputs) / sizeof(exploreInputs[0]))
+
+static ExploreShared* ex;
+static int (*exploreSs)(int);			// the firmware's ss()
+static int exploreNode = -1;			// context this process expands
+static int exploreVia = -1;				// transition this process just measured
+static unsigned short exploreDepth;
+static uint64_t exploreDeadline;
+static pid_t exploreRoot;
+static unsigned exploreTop = 10;
+static unsigned explorePeriod = 300;
+static const char* exploreWrite;
+static const char* exploreCompare;
+
+static double explore_ms(uint64_t cycles)
+{
+	return cycles / (double)HAL_CYCLES_PER_MS;
+}
+
+static void explore_screen(char out[17])
+{
+	char rows[2][17];
+	hal_lcd_visible(rows);
+	memcpy(out, rows[0], 17);
+}
+
+static void explore_input(unsigned char i)
+{
+	const char* s = exploreInputs[i];
+	halAnalog[4] = EXPLORE_CENTER;
+	halAnalog[5] = EXPLORE_CENTER;
+	halKey = '\0';
+	if (!strcmp(s, "up"))    { halAnalog[4] = 0; }
+	if (!strcmp(s, "down"))  { halAnalog[4] = 1023; }
+	if (!strcmp(s, "left"))  { halAnalog[5] = 0; }
+	if (!strcmp(s, "right")) { halAnalog[5] = 1023; }
+	if (!strncmp(s, "key ", 4)) { halKey = s[4]; }
+	// reader() has already sampled the joystick this round
+	LR = halAnalog[4];
+	UD = halAnalog[5];
+}
+
+static ExploreKey explore_key(void)
+{
+	ExploreKey k;
+	k.stater = stater;
+	k.gotit = gotit;
+	k.memSlot = memSlot;
+	k.curveN = (curve.n < 2) ? curve.n : 2;
+	return k;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Claims the current context for this process
+//Parameter: None
+//Returns: The new node, or -1 if the context was seen or the table is full
+static int explore_claim(void)
+{
+	ExploreKey k = explore_key();
+	ExploreNode* n;
+	int i;
+
+	for (i = 0; i < ex->nodes; ++i) {
+		n = &ex->node[i];
+		if (memcmp(&n->key, &k, sizeof(k))) { continue; }
+		// seen: keep the shorter way there for the report
+		if (exploreDepth < n->depth) {
+			n->via = exploreVia;
+			n->depth = exploreDepth;
+		}
+		return -1;
+	}
+	if (ex->nodes == EXPLORE_NODES) {
+		++ex->dropped;
+		return -1;
+	}
+	n = &ex->node[ex->nodes];
+	n->key = k;
+	n->via = exploreVia;
+	n->depth = exploreDepth;
+	explore_screen(n->screen);
+	return ex->nodes++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Runs one ss() call under an input and records its cost
+//Parameter: The task state and the input
+//Returns: What ss() returned
+static int explore_measure(int state, unsigned char input)
+{
+	uint64_t cycles = halCycles;
+	uint32_t ops = halLcdOps;
+	uint32_t writes = halEepromWrites;
+	ExploreTrans* t;
+	int r;
+
+	explore_input(input);
+	r = exploreSs(state);
+	if (ex->trans == EXPLORE_TRANS) {
+		++ex->dropped;
+		_exit(0);
+	}
+	exploreVia = ex->trans++;
+	t = &ex->tran[exploreVia];
+	t->from = exploreNode;
+	t->input = input;
+	t->to = stater;
+	t->cycles = halCycles - cycles;
+	t->lcdOps = halLcdOps - ops;
+	t->eeWrites = halEepromWrites - writes;
+	explore_screen(t->screen);
+	explore_input(0);
+	return r;
+}
+
+static void explore_report(void);
+
+////////////////////////////////////////////////////////////////////////////////
+//Functionality - Stands in for ss() as the UI task: expands the context the
+//				  firmware is in, one forked child per input
+//Parameter: The task state
+//Returns: The next task state
+static int explore_tick(int state)
+{
+	unsigned char i;
+	pid_t pid;
+
+	if (state < 0) { return exploreSs(state); }	// not drawn yet
+	if (exploreDepth >= EXPLORE_DEPTH) {
+		++ex->dropped;
+		_exit(0);
+	}
+	exploreNode = explore_claim();
+	if (exploreNode < 0) { _exit(0); }
+
+	for (i = 0; i < EXPLORE_INPUTS; ++i) {
+		fflush(stdout);
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			_exit(1);
+		}
+		if (pid == 0) {
+			++exploreDepth;
+			exploreDeadline = halCycles + (uint64_t)EXPLORE_TIMEOUT_MS * HAL_CYCLES_PER_MS;
+			return explore_measure(state, i);
+		}
+		waitpid(pid, 0, 0);
+	}
+	if (getpid() == exploreRoot) {
+		explore_report();
+		exit(0);
+	}
+	_exit(0);
+}
+
+void sim_tick(void)
+{
+	if (uiTask && uiTask->TickFct != explore_tick) {
+		exploreSs = uiTask->TickFct;
+		uiTask->TickFct = explore_tick;
+	}
+	if (exploreDeadline && halCycles > exploreDeadline) {
+		++ex->dropped;
+		_exit(0);
+	}
+}
+
+void sim_usart_tx(uint8_t n, uint8_t byte)
+{
+	(void)n;
+	(void)byte;
+}
+
+void sim_end(void)
+{
+	if (getpid() != exploreRoot) { _exit(0); }
+	fprintf(stderr, "explore: the firmware stopped before the UI came up\n");
+	exit(1);
+}
+
+/* ----------  REPORT  ---------- */
+
+typedef struct ExploreWorst {
+	int tran;							// -1 if the screen was never left from
+	char screen[17];
+} ExploreWorst;
+
+static ExploreWorst exploreWorst[EXPLORE_STATES];
+
+static void explore_path(int node)
+{
+	int hops[EXPLORE_DEPTH + 1];
+	int n = 0;
+
+	while (node >= 0 && ex->node[node].via >= 0 && n < EXPLORE_DEPTH + 1) {
+		hops[n++] = ex->node[node].via;
+		node = ex->tran[ex->node[node].via].from;
+	}
+	printf("     path: start");
+	while (n--) { printf(" > %s", exploreInputs[ex->tran[hops[n]].input]); }
+	printf("\n");
+}
+
+static int explore_by_cost(const void* a, const void* b)
+{
+	uint64_t x = ex->tran[*(const int*)a].cycles;
+	uint64_t y = ex->tran[*(const int*)b].cycles;
+	return (x < y) - (x > y);
+}
+
+static int explore_same(int a, int b)
+{
+	const ExploreTrans* x = &ex->tran[a];
+	const ExploreTrans* y = &ex->tran[b];
+	return x->input == y->input && x->to == y->to && ex->node[x->from].key.stater == ex->node[y->from].key.stater;
+}
+
+static void explore_print(const ExploreTrans* t)
+{
+	const ExploreNode* n = &ex->node[t->from];
+	printf("%8.2f ms %5u lcd %3u ee  [%2u |%s|] %-6s -> [%2u |%s|]\n",
+		explore_ms(t->cycles), t->lcdOps, t->eeWrites,
+		n->key.stater, n->screen, exploreInputs[t->input], t->to, t->screen);
+}
+
+static void explore_compare(void)
+{
+	FILE* f = fopen(exploreCompare, "r");
+	char line[128], screen[17];
+	unsigned st, ops, ee, s;
+	double ms, now;
+	int seen[EXPLORE_STATES] = { 0 };
+
+	if (!f) {
+		perror(exploreCompare);
+		return;
+	}
+	printf("\nworst case per screen against %s:\n", exploreCompare);
+	while (fgets(line, sizeof(line), f)) {
+		// <stater> <ms> <lcd ops> <ee writes> |<screen>|
+		char* bar = strchr(line, '|');
+		if (!bar || sscanf(line, "%u %lf %u %u", &st, &ms, &ops, &ee) != 4 || strlen(bar) < 18) { continue; }
+		memcpy(screen, bar + 1, 16);
+		screen[16] = '\0';
+		// matched by the text on screen, as the state numbers move when screens
+		// are added; screens that share a text pair up in order
+		for (s = 0; s < EXPLORE_STATES; ++s) {
+			if (exploreWorst[s].tran >= 0 && !seen[s] && !strcmp(exploreWorst[s].screen, screen)) { break; }
+		}
+		if (s == EXPLORE_STATES) {
+			printf("  |%s| %8.2f ms -> gone\n", screen, ms);
+			continue;
+		}
+		seen[s] = 1;
+		now = explore_ms(ex->tran[exploreWorst[s].tran].cycles);
+		printf("  |%s| %8.2f ms -> %8.2f ms  %+8.2f ms%s\n", screen, ms, now, now - ms,
+			(now > ms * 1.05 + 0.1) ? "  slower" : (now < ms * 0.95 - 0.1) ? "  faster" : "");
+	}
+	fclose(f);
+	for (s = 0; s < EXPLORE_STATES; ++s) {
+		if (exploreWorst[s].tran >= 0 && !seen[s]) {
+			printf("  |%s|      new -> %8.2f ms\n", exploreWorst[s].screen, explore_ms(ex->tran[exploreWorst[s].tran].cycles));
+		}
+	}
+}
+
+static void explore_report(void)
+{
+	int* order = malloc(sizeof(int) * (ex->trans ? ex->trans : 1));
+	uint64_t period = (uint64_t)explorePeriod * HAL_CYCLES_PER_MS;
+	unsigned screens = 0, over = 0, shown;
+	FILE* f;
+	int i, j;
+
+	for (i = 0; i < EXPLORE_STATES; ++i) { exploreWorst[i].tran = -1; }
+	for (i = 0; i < ex->nodes; ++i) {
+		ExploreWorst* w = &exploreWorst[ex->node[i].key.stater];
+		if (w->tran < 0 && !w->screen[0]) {
+			memcpy(w->screen, ex->node[i].screen, 17);
+			++screens;
+		}
+	}
+	for (i = 0; i < ex->trans; ++i) {
+		ExploreWorst* w = &exploreWorst[ex->node[ex->tran[i].from].key.stater];
+		if (w->tran < 0 || ex->tran[i].cycles > ex->tran[w->tran].cycles) { w->tran = i; }
+		order[i] = i;
+	}
+	qsort(order, ex->trans, sizeof(int), explore_by_cost);
+
+	printf("explored %d contexts on %u screens, %d transitions", ex->nodes, screens, ex->trans);
+	if (ex->dropped) { printf(" (%d branches cut at a limit)", ex->dropped); }
+	printf("\n\nmost expensive UI ticks:\n");
+	for (i = 0, shown = 0; i < ex->trans && shown < exploreTop; ++i) {
+		// the same move from the same screen in another context only once
+		for (j = 0; j < i && !explore_same(order[i], order[j]); ++j) {}
+		if (j < i) { continue; }
+		printf("%3u.", ++shown);
+		explore_print(&ex->tran[order[i]]);
+		explore_path(ex->tran[order[i]].from);
+	}
+
+	printf("\nover the %u ms UI period:\n", explorePeriod);
+	for (i = 0; i < ex->trans && ex->tran[order[i]].cycles > period; ++i, ++over) {
+		printf("    ");
+		explore_print(&ex->tran[order[i]]);
+	}
+	if (!over) { printf("    none\n"); }
+
+	printf("\nworst case per screen:\n");
+	for (i = 0; i < EXPLORE_STATES; ++i) {
+		if (exploreWorst[i].tran >= 0) {
+			printf("    ");
+			explore_print(&ex->tran[exploreWorst[i].tran]);
+		}
+	}
+
+	if (exploreCompare) { explore_compare(); }
+	if (exploreWrite && (f = fopen(exploreWrite, "w"))) {
+		for (i = 0; i < EXPLORE_STATES; ++i) {
+			const ExploreTrans* t;
+			if (exploreWorst[i].tran < 0) { continue; }
+			t = &ex->tran[exploreWorst[i].tran];
+			fprintf(f, "%d %.2f %u %u |%s| %s\n", i, explore_ms(t->cycles), t->lcdOps, t->eeWrites,
+				exploreWorst[i].screen, exploreInputs[t->input]);
+		}
+		fclose(f);
+	}
+	free(order);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	const char* image = 0;
+	FILE* f;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc) { exploreTop = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-p") && i + 1 < argc) { explorePeriod = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-e") && i + 1 < argc) { image = argv[++i]; }
+		else if (!strcmp(argv[i], "-w") && i + 1 < argc) { exploreWrite = argv[++i]; }
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc) { exploreCompare = argv[++i]; }
+		else {
+			fprintf(stderr, "usage: %s [-n 10] [-p 300] [-e eeprom.bin] [-w worst.txt] [-c worst.txt]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	ex = mmap(0, sizeof(ExploreShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ex == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	memset(halEeprom, 0xFF, sizeof(halEeprom));
+	memset(halLcd, ' ', sizeof(halLcd));
+	if (image && (f = fopen(image, "rb"))) {
+		if (fread(halEeprom, 1, sizeof(halEeprom), f) != sizeof(halEeprom)) {
+			fprintf(stderr, "explore: short EEPROM image %s\n", image);
+		}
+		fclose(f);
+	}
+	// steady sensors, so no screen redraws for a reading that moved
+	halSensorChannels = (1 << EXPLORE_MS_CH) | (1 << EXPLORE_SUN_CH);
+	halAnalog[EXPLORE_MS_CH] = 600;
+	halAnalog[EXPLORE_SUN_CH] = 500;
+	explore_input(0);
+	exploreRoot = getpid();
+
+	firmware_main();
+	sim_end();
+	return 0;
+}
@@ -0,0 +1,722 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Simulated ATmega1284 peripherals for the host build: 16-bit timers 1 and 3,
+// interrupt dispatch, ADC, both USARTs, EEPROM, the keypad matrix on port B
+// and the HD44780 on ports C/D. See hal.h.
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <string.h>
+
+// Plain registers
+volatile uint8_t PORTA, PORTB, PORTC, PORTD;
+volatile uint8_t DDRA, DDRB, DDRC, DDRD;
+volatile uint8_t ADMUX, ADCSRB, DIDR0;
+volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1;
+volatile uint16_t OCR1A, OCR1B, ICR1;
+volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3;
+volatile uint16_t OCR3A, OCR3B, ICR3;
+volatile uint8_t SREG, MCUSR, MCUCR, SMCR, WDTCSR, GPIOR0, PRR0, SPMCSR;
+volatile uint8_t UCSR0B, UCSR0C, UBRR0L, UBRR0H;
+volatile uint8_t UCSR1B, UCSR1C, UBRR1L, UBRR1H;
+volatile uint8_t SPCR, SPSR, SPDR;
+volatile uint8_t SPL = 0xFF, SPH = 0x40;
+
+#define HAL_SLEEP_STEP (10 * HAL_CYCLES_PER_MS)	// longest idle stretch between sim_tick() calls
+
+uint64_t halCycles;
+static uint64_t halNextSync;			// next time hal_nop() has to look at the peripherals
+static uint32_t halServed;				// interrupts dispatched so far
+
+// Default (empty) vectors, replaced by the firmware's ISR() definitions
+#define HAL_VECTOR(name) void name(void) __attribute__((weak)); void name(void) {}
+HAL_VECTOR(WDT_vect)
+HAL_VECTOR(TIMER1_COMPA_vect)
+HAL_VECTOR(TIMER1_COMPB_vect)
+HAL_VECTOR(TIMER1_OVF_vect)
+HAL_VECTOR(SPI_STC_vect)
+HAL_VECTOR(USART0_RX_vect)
+HAL_VECTOR(ADC_vect)
+HAL_VECTOR(USART1_RX_vect)
+HAL_VECTOR(TIMER3_COMPA_vect)
+HAL_VECTOR(TIMER3_OVF_vect)
+
+static void (* const halVectors[HAL_IRQ_COUNT])(void) = {
+	WDT_vect,
+	TIMER1_COMPA_vect,
+	TIMER1_COMPB_vect,
+	TIMER1_OVF_vect,
+	SPI_STC_vect,
+	USART0_RX_vect,
+	ADC_vect,
+	USART1_RX_vect,
+	TIMER3_COMPA_vect,
+	TIMER3_OVF_vect
+};
+
+static uint8_t halRaised[HAL_IRQ_COUNT];	// sources without a flag register
+static uint8_t halRaisedAny;
+
+/* ----------  TIMERS  ---------- */
+
+typedef struct HalTimer {
+	volatile uint8_t* tccra;
+	volatile uint8_t* tccrb;
+	volatile uint16_t* ocra;
+	volatile uint16_t* ocrb;
+	volatile uint16_t* icr;
+	volatile uint8_t* timsk;
+	uint8_t tifr;			// flags: bit0 TOV, bit1 OCFA, bit2 OCFB
+	uint16_t tcnt;			// count at cycle 'at'
+	uint64_t at;
+	uint16_t tcntOut;		// value handed out through hal_tcnt()
+	uint16_t tcntLent;		// what tcntOut held when it was handed out
+	uint8_t tifrOut;
+	uint8_t tifrLent;
+} HalTimer;
+
+static HalTimer halTimer1 = { &TCCR1A, &TCCR1B, &OCR1A, &OCR1B, &ICR1, &TIMSK1 };
+static HalTimer halTimer3 = { &TCCR3A, &TCCR3B, &OCR3A, &OCR3B, &ICR3, &TIMSK3 };
+
+// log2 of the clock prescaler, -1 while the timer is stopped (or clocked externally)
+static int8_t hal_timer_prescale(HalTimer* t)
+{
+	static const int8_t shift[8] = { -1, 0, 3, 6, 8, 10, -1, -1 };
+	return shift[*t->tccrb & 0x07];
+}
+
+static uint32_t hal_timer_top(HalTimer* t)
+{
+	uint8_t wgm = (*t->tccra & 0x03) | ((*t->tccrb >> 1) & 0x0C);
+	switch (wgm) {
+		case 4:  return *t->ocra;		// CTC, TOP = OCRnA
+		case 12: return *t->icr;		// CTC, TOP = ICRn
+		case 14: return *t->icr;		// fast PWM, TOP = ICRn
+		case 15: return *t->ocra;		// fast PWM, TOP = OCRnA
+		case 5:  return 0xFF;
+		case 6:  return 0x1FF;
+		case 7:  return 0x3FF;
+		default: return 0xFFFF;
+	}
+}
+
+// ticks from count 'cnt' until the counter next equals 'target' (1..period)
+static uint32_t hal_timer_dist(uint32_t cnt, uint32_t target, uint32_t period)
+{
+	return (target > cnt) ? target - cnt : target + period - cnt;
+}
+
+static void hal_timer_run(HalTimer* t)
+{
+	int8_t ps = hal_timer_prescale(t);
+	uint32_t top, period, ticks, cnt, d, dA, dB, dTop;
+	uint64_t n;
+
+	if (ps < 0) {
+		t->at = halCycles;
+		return;
+	}
+	n = (halCycles - t->at) >> ps;
+	if (n == 0) { return; }
+	t->at += n << ps;
+	top = hal_timer_top(t);
+	period = top + 1;
+	if (t->tcnt > top) { t->tcnt = 0; }
+
+	// skip whole periods; every event of the period fires once
+	if (n > period) {
+		if (*t->ocra <= top) { t->tifr |= 0x02; }
+		if (*t->ocrb <= top) { t->tifr |= 0x04; }
+		if (top == 0xFFFF || hal_timer_top(t) != 0xFFFF) { t->tifr |= 0x01; }
+		n %= period;
+	}
+	ticks = (uint32_t)n;
+	while (ticks) {
+		cnt = t->tcnt;
+		dA = (*t->ocra <= top) ? hal_timer_dist(cnt, *t->ocra, period) : 0xFFFFFFFF;
+		dB = (*t->ocrb <= top) ? hal_timer_dist(cnt, *t->ocrb, period) : 0xFFFFFFFF;
+		dTop = top - cnt + 1;						// wrap to 0
+		d = ticks;
+		if (dA < d) { d = dA; }
+		if (dB < d) { d = dB; }
+		if (dTop < d) { d = dTop; }
+		cnt += d;
+		t->tcnt = (cnt >= period) ? cnt - period : cnt;
+		ticks -= d;
+		if (d == dA) { t->tifr |= 0x02; }
+		if (d == dB) { t->tifr |= 0x04; }
+		if (d == dTop && (top == 0xFFFF || (*t->tccra & 0x03))) { t->tifr |= 0x01; }
+	}
+}
+
+// cycles until the next interrupt-enabled event of a timer
+static uint64_t hal_timer_next(HalTimer* t)
+{
+	int8_t ps = hal_timer_prescale(t);
+	uint32_t top = hal_timer_top(t);
+	uint32_t period = top + 1;
+	uint32_t d = 0xFFFFFFFF;
+	uint32_t x;
+	uint8_t en = *t->timsk;
+
+	if (ps < 0 || !(en & 0x07)) { return UINT64_MAX; }
+	if ((en & 0x02) && *t->ocra <= top) { x = hal_timer_dist(t->tcnt, *t->ocra, period); if (x < d) { d = x; } }
+	if ((en & 0x04) && *t->ocrb <= top) { x = hal_timer_dist(t->tcnt, *t->ocrb, period); if (x < d) { d = x; } }
+	if (en & 0x01) { x = top - t->tcnt + 1; if (x < d) { d = x; } }
+	if (d == 0xFFFFFFFF) { return UINT64_MAX; }
+	return t->at + ((uint64_t)d << ps);
+}
+
+static HalTimer* hal_timer(uint8_t n)
+{
+	return (n == 3) ? &halTimer3 : &halTimer1;
+}
+
+// Firmware writes to TCNTn/TIFRn land in the value handed out; pick them up
+static void hal_timer_commit(HalTimer* t)
+{
+	if (t->tcntOut != t->tcntLent) {
+		hal_timer_run(t);
+		t->tcnt = t->tcntOut;
+		t->at = halCycles;
+	}
+	if (t->tifrOut != t->tifrLent) {
+		hal_timer_run(t);
+		t->tifr &= ~t->tifrOut;			// write one to clear
+	}
+	t->tcntOut = t->tcntLent = 0;
+	t->tifrOut = t->tifrLent = 0;
+}
+
+volatile uint16_t* hal_tcnt(uint8_t n)
+{
+	HalTimer* t = hal_timer(n);
+	hal_timer_commit(t);
+	hal_timer_run(t);
+	t->tcntOut = t->tcntLent = t->tcnt;
+	return (volatile uint16_t*)&t->tcntOut;
+}
+
+volatile uint8_t* hal_tifr(uint8_t n)
+{
+	HalTimer* t = hal_timer(n);
+	hal_timer_commit(t);
+	hal_timer_run(t);
+	t->tifrOut = t->tifrLent = t->tifr;
+	return (volatile uint8_t*)&t->tifrOut;
+}
+
+/* ----------  ADC  ---------- */
+
+uint16_t halAnalog[8];
+uint8_t halSensorChannels;
+static uint8_t halAdcsra;
+static uint8_t halAdcsraOut;
+static uint16_t halAdcResult;
+static uint64_t halAdcDone = UINT64_MAX;
+
+static uint32_t hal_adc_cycles(void)
+{
+	uint8_t ps = halAdcsra & 0x07;
+	return 13UL << (ps ? ps : 1);
+}
+
+// A channel fed from the sensor supply reads 0 while PD4 is low
+static uint16_t hal_analog(uint8_t ch)
+{
+	if ((halSensorChannels & (1 << ch)) && !(PORTD & (1 << PD4))) { return 0; }
+	return halAnalog[ch] & 0x3FF;
+}
+
+static void hal_adc_run(void)
+{
+	uint32_t conv;
+	if (halCycles < halAdcDone) { return; }
+	halAdcResult = hal_analog(ADMUX & 0x07);
+	halAdcsra |= (1 << ADIF);
+	if ((halAdcsra & (1 << ADATE)) && (halAdcsra & (1 << ADEN))) {
+		conv = hal_adc_cycles();
+		halAdcDone += ((halCycles - halAdcDone) / conv + 1) * conv;	// free running
+	}
+	else {
+		halAdcsra &= ~(1 << ADSC);
+		halAdcDone = UINT64_MAX;
+	}
+}
+
+static void hal_adc_commit(void)
+{
+	uint8_t w = halAdcsraOut;
+	if (w == halAdcsra) { return; }
+	if (w & (1 << ADIF)) { w &= ~(1 << ADIF); } else { w |= halAdcsra & (1 << ADIF); }
+	if ((w & (1 << ADSC)) && (w & (1 << ADEN)) && halAdcDone == UINT64_MAX) {
+		halAdcDone = halCycles + hal_adc_cycles();
+	}
+	halAdcsra = w;
+	halAdcsraOut = w;
+}
+
+volatile uint8_t* hal_adcsra(void)
+{
+	hal_adc_commit();
+	hal_adc_run();
+	halAdcsraOut = halAdcsra;
+	return (volatile uint8_t*)&halAdcsraOut;
+}
+
+uint16_t hal_adc(void)
+{
+	hal_adc_commit();
+	hal_adc_run();
+	// free running: the channel selected when the read happens has converted
+	if (halAdcsra & (1 << ADATE)) {
+		halAdcResult = hal_analog(ADMUX & 0x07);
+	}
+	return halAdcResult;
+}
+
+/* ----------  USART  ---------- */
+
+typedef struct HalUsart {
+	volatile uint8_t* ucsrb;
+	uint8_t slot;			// what UDRn reads as / was written to
+	uint8_t offered;
+	uint8_t mode;			// 0 idle, 1 rx byte offered, 2 write expected
+	uint8_t status;
+	uint8_t rx[64];
+	uint8_t head;
+	uint8_t tail;
+} HalUsart;
+
+static HalUsart halUsart[2] = { { &UCSR0B }, { &UCSR1B } };
+
+static void hal_usart_commit(HalUsart* u, uint8_t n)
+{
+	if (u->mode == 2 || (u->mode == 1 && u->slot != u->offered)) {
+		if (*u->ucsrb & 0x08) { sim_usart_tx(n, u->slot); }	// TXEN
+	}
+	else if (u->mode == 1) {
+		u->tail = (u->tail + 1) & 63;
+	}
+	u->mode = 0;
+}
+
+int hal_usart_rx_push(uint8_t n, uint8_t byte)
+{
+	HalUsart* u = &halUsart[n & 1];
+	uint8_t next = (u->head + 1) & 63;
+	if (next == u->tail) { return 0; }
+	u->rx[u->head] = byte;
+	u->head = next;
+	return 1;
+}
+
+volatile uint8_t* hal_udr(uint8_t n)
+{
+	HalUsart* u = &halUsart[n & 1];
+	hal_usart_commit(u, n);
+	if (u->head != u->tail) {
+		u->slot = u->offered = u->rx[u->tail];
+		u->mode = 1;
+	}
+	else {
+		u->mode = 2;
+	}
+	return (volatile uint8_t*)&u->slot;
+}
+
+volatile uint8_t* hal_ucsra(uint8_t n)
+{
+	HalUsart* u = &halUsart[n & 1];
+	hal_usart_commit(u, n);
+	u->status = (1 << UDRE0) | (1 << TXC0) | ((u->head != u->tail) ? (1 << RXC0) : 0);
+	return (volatile uint8_t*)&u->status;
+}
+
+/* ----------  EEPROM  ---------- */
+
+uint8_t halEeprom[HAL_EEPROM_SIZE];
+uint32_t halEepromWrites;
+static uint64_t halEepromBusy;
+
+#define HAL_EEPROM_WRITE_CYCLES (34UL * HAL_CYCLES_PER_MS / 10)	// 3.4 ms
+
+static void hal_advance_to(uint64_t cycle);
+
+static void hal_eeprom_wait(void)
+{
+	if (halCycles < halEepromBusy) { hal_advance_to(halEepromBusy); }
+}
+
+int eeprom_is_ready(void)
+{
+	return halCycles >= halEepromBusy;
+}
+
+void eeprom_busy_wait(void)
+{
+	hal_eeprom_wait();
+}
+
+uint8_t eeprom_read_byte(const uint8_t* addr)
+{
+	hal_eeprom_wait();
+	return halEeprom[(uintptr_t)addr % HAL_EEPROM_SIZE];
+}
+
+uint16_t eeprom_read_word(const uint16_t* addr)
+{
+	const uint8_t* a = (const uint8_t*)addr;
+	return eeprom_read_byte(a) | (eeprom_read_byte(a + 1) << 8);
+}
+
+void eeprom_read_block(void* dst, const void* src, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; ++i) { ((uint8_t*)dst)[i] = eeprom_read_byte((const uint8_t*)src + i); }
+}
+
+void eeprom_write_byte(uint8_t* addr, uint8_t value)
+{
+	hal_eeprom_wait();
+	halEeprom[(uintptr_t)addr % HAL_EEPROM_SIZE] = value;
+	halEepromBusy = halCycles + HAL_EEPROM_WRITE_CYCLES;
+	++halEepromWrites;
+}
+
+void eeprom_write_word(uint16_t* addr, uint16_t value)
+{
+	eeprom_write_byte((uint8_t*)addr, (uint8_t)value);
+	eeprom_write_byte((uint8_t*)addr + 1, (uint8_t)(value >> 8));
+}
+
+void eeprom_write_block(const void* src, void* dst, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; ++i) { eeprom_write_byte((uint8_t*)dst + i, ((const uint8_t*)src)[i]); }
+}
+
+void eeprom_update_byte(uint8_t* addr, uint8_t value)
+{
+	if (eeprom_read_byte(addr) != value) { eeprom_write_byte(addr, value); }
+}
+
+void eeprom_update_word(uint16_t* addr, uint16_t value)
+{
+	eeprom_update_byte((uint8_t*)addr, (uint8_t)value);
+	eeprom_update_byte((uint8_t*)addr + 1, (uint8_t)(value >> 8));
+}
+
+void eeprom_update_block(const void* src, void* dst, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; ++i) { eeprom_update_byte((uint8_t*)dst + i, ((const uint8_t*)src)[i]); }
+}
+
+/* ----------  LCD  ---------- */
+
+char halLcd[2][40];
+uint8_t halLcdShift;
+uint32_t halLcdOps;
+uint32_t halLcdVersion;
+static uint8_t halLcdCgram[64];
+static uint8_t halLcdAddr;			// DDRAM address (0x00-0x27, 0x40-0x67) or CGRAM address
+static uint8_t halLcdCg;			// 1 while the address counter points into CGRAM
+static uint8_t halLcdInc = 1;
+static uint8_t halLcdShiftOnWrite;
+static uint8_t halLcdE;
+
+static void hal_lcd_step(int8_t dir)
+{
+	if (halLcdCg) {
+		halLcdAddr = (halLcdAddr + dir) & 0x3F;
+		return;
+	}
+	if (dir > 0) {
+		halLcdAddr = (halLcdAddr == 0x27) ? 0x40 : (halLcdAddr == 0x67) ? 0x00 : halLcdAddr + 1;
+	}
+	else {
+		halLcdAddr = (halLcdAddr == 0x00) ? 0x67 : (halLcdAddr == 0x40) ? 0x27 : halLcdAddr - 1;
+	}
+}
+
+static void hal_lcd_latch(uint8_t rs, uint8_t b)
+{
+	++halLcdOps;
+	if (rs) {
+		if (halLcdCg) {
+			halLcdCgram[halLcdAddr & 0x3F] = b;
+		}
+		else {
+			halLcd[halLcdAddr >= 0x40][(halLcdAddr & 0x3F) % 40] = (char)b;
+			if (halLcdShiftOnWrite) { halLcdShift = (halLcdShift + (halLcdInc ? 1 : 39)) % 40; }
+		}
+		hal_lcd_step(halLcdInc ? 1 : -1);
+		++halLcdVersion;
+	}
+	else if (b & 0x80) {
+		halLcdAddr = b & 0x7F;
+		halLcdCg = 0;
+	}
+	else if (b & 0x40) {
+		halLcdAddr = b & 0x3F;
+		halLcdCg = 1;
+	}
+	else if (b & 0x20) {
+		// function set
+	}
+	else if (b & 0x10) {
+		if (b & 0x08) { halLcdShift = (halLcdShift + ((b & 0x04) ? 39 : 1)) % 40; ++halLcdVersion; }
+		else if (!halLcdCg) { hal_lcd_step((b & 0x04) ? 1 : -1); }
+	}
+	else if (b & 0x08) {
+		// display on/off control
+	}
+	else if (b & 0x04) {
+		halLcdInc = (b & 0x02) != 0;
+		halLcdShiftOnWrite = b & 0x01;
+	}
+	else if (b & 0x02) {
+		halLcdAddr = 0;
+		halLcdCg = 0;
+		halLcdShift = 0;
+		++halLcdVersion;
+	}
+	else if (b & 0x01) {
+		memset(halLcd, ' ', sizeof(halLcd));
+		halLcdAddr = 0;
+		halLcdCg = 0;
+		halLcdShift = 0;
+		halLcdInc = 1;
+		++halLcdVersion;
+	}
+}
+
+void hal_lcd_visible(char out[2][17])
+{
+	uint8_t r, c;
+	for (r = 0; r < 2; ++r) {
+		for (c = 0; c < 16; ++c) {
+			char ch = halLcd[r][(halLcdShift + c) % 40];
+			out[r][c] = (ch >= 0x20 && ch < 0x7F) ? ch : ((unsigned char)ch < 16) ? '#' : ((unsigned char)ch == 0xFF) ? '=' : '?';	// '#': CGRAM glyph, '=': full block
+		}
+		out[r][16] = '\0';
+	}
+}
+
+/* ----------  PINS  ---------- */
+
+char halKey;
+
+uint8_t hal_pin(uint8_t port)
+{
+	static const char keys[4][4] = {
+		{ '1', '2', '3', 'A' },
+		{ '4', '5', '6', 'B' },
+		{ '7', '8', '9', 'C' },
+		{ '*', '0', '#', 'D' }
+	};
+	uint8_t r, c, pin;
+
+	switch (port) {
+		case 0: return PORTA;
+		case 2: return PORTC;
+		case 3: return PORTD;
+	}
+	// keypad: columns driven low on PB4-7, rows read on PB0-3 with pull-ups
+	pin = (PORTB & 0xF0) | 0x0F;
+	for (r = 0; r < 4; ++r) {
+		for (c = 0; c < 4; ++c) {
+			if (halKey == keys[r][c] && !(PORTB & (0x10 << c))) { pin &= ~(1 << r); }
+		}
+	}
+	return pin;
+}
+
+/* ----------  INTERRUPTS AND TIME  ---------- */
+
+void hal_raise(uint8_t irq)
+{
+	if (irq < HAL_IRQ_COUNT) { halRaised[irq] = 1; halRaisedAny = 1; }
+}
+
+void hal_sei(void)
+{
+	SREG |= 0x80;
+}
+
+void hal_cli(void)
+{
+	SREG &= ~0x80;
+}
+
+void hal_isr_enter(const char* attrs)
+{
+	if (*attrs && strstr(attrs, "NOBLOCK")) { SREG |= 0x80; }
+}
+
+/* ----------  OUTPUT PINS  ---------- */
+
+uint64_t halDriveCycles;
+static uint64_t halDriveAt;
+static uint8_t halDriveOn;
+uint64_t halSensorCycles;
+static uint8_t halSensorOn;
+
+// Accounts the time OC1A (PD5) drove the valve, where any duty holds it
+// open, and the time the sensor supply (PD4) was on
+static void hal_drive_run(void)
+{
+	if (halDriveOn) { halDriveCycles += halCycles - halDriveAt; }
+	if (halSensorOn) { halSensorCycles += halCycles - halDriveAt; }
+	halDriveAt = halCycles;
+	halSensorOn = (PORTD & (1 << PD4)) != 0;
+	if (TCCR1A & (1 << COM1A1)) {
+		halDriveOn = OCR1A != 0 && hal_timer_prescale(&halTimer1) >= 0;
+	}
+	else {
+		halDriveOn = (PORTD & (1 << PD5)) != 0;
+	}
+}
+
+// Brings every peripheral up to halCycles
+static void hal_sync(void)
+{
+	hal_drive_run();
+	hal_timer_commit(&halTimer1);
+	hal_timer_commit(&halTimer3);
+	hal_timer_run(&halTimer1);
+	hal_timer_run(&halTimer3);
+	hal_adc_commit();
+	hal_adc_run();
+	hal_usart_commit(&halUsart[0], 0);
+	hal_usart_commit(&halUsart[1], 1);
+}
+
+// Returns the highest priority interrupt that is pending and enabled
+static int hal_pending(void)
+{
+	uint8_t i;
+	if (!(halTimer1.tifr & TIMSK1) && !(halTimer3.tifr & TIMSK3) && !(halAdcsra & (1 << ADIF))
+		&& halUsart[0].head == halUsart[0].tail && halUsart[1].head == halUsart[1].tail
+		&& !halRaisedAny) {
+		return -1;
+	}
+	for (i = 0; i < HAL_IRQ_COUNT; ++i) {
+		switch (i) {
+			case HAL_IRQ_TIMER1_COMPA: if ((halTimer1.tifr & 0x02) && (TIMSK1 & 0x02)) { return i; } break;
+			case HAL_IRQ_TIMER1_COMPB: if ((halTimer1.tifr & 0x04) && (TIMSK1 & 0x04)) { return i; } break;
+			case HAL_IRQ_TIMER1_OVF:   if ((halTimer1.tifr & 0x01) && (TIMSK1 & 0x01)) { return i; } break;
+			case HAL_IRQ_TIMER3_COMPA: if ((halTimer3.tifr & 0x02) && (TIMSK3 & 0x02)) { return i; } break;
+			case HAL_IRQ_TIMER3_OVF:   if ((halTimer3.tifr & 0x01) && (TIMSK3 & 0x01)) { return i; } break;
+			case HAL_IRQ_ADC:          if ((halAdcsra & (1 << ADIF)) && (halAdcsra & (1 << ADIE))) { return i; } break;
+			case HAL_IRQ_USART0_RX:    if (halUsart[0].head != halUsart[0].tail && (UCSR0B & (1 << RXCIE0))) { return i; } break;
+			case HAL_IRQ_USART1_RX:    if (halUsart[1].head != halUsart[1].tail && (UCSR1B & (1 << RXCIE1))) { return i; } break;
+			default:                   if (halRaised[i]) { return i; } break;
+		}
+	}
+	return -1;
+}
+
+// Runs every pending interrupt the way the core would
+static void hal_dispatch(void)
+{
+	int irq;
+	while ((SREG & 0x80) && (irq = hal_pending()) >= 0) {
+		switch (irq) {
+			case HAL_IRQ_TIMER1_COMPA: halTimer1.tifr &= ~0x02; break;
+			case HAL_IRQ_TIMER1_COMPB: halTimer1.tifr &= ~0x04; break;
+			case HAL_IRQ_TIMER1_OVF:   halTimer1.tifr &= ~0x01; break;
+			case HAL_IRQ_TIMER3_COMPA: halTimer3.tifr &= ~0x02; break;
+			case HAL_IRQ_TIMER3_OVF:   halTimer3.tifr &= ~0x01; break;
+			case HAL_IRQ_ADC:          halAdcsra &= ~(1 << ADIF); break;
+			default:
+				halRaised[irq] = 0;
+				halRaisedAny = (uint8_t)(memchr(halRaised, 1, sizeof(halRaised)) != 0);
+				break;
+		}
+		halCycles += 8;		// vector + prologue
+		SREG &= ~0x80;
+		halVectors[irq]();
+		hal_drive_run();
+		++halServed;
+		SREG |= 0x80;		// reti
+		hal_usart_commit(&halUsart[0], 0);
+		hal_usart_commit(&halUsart[1], 1);
+	}
+}
+
+/* ----------  WATCHDOG  ---------- */
+
+uint32_t halWdtResets;
+static uint64_t halWdtPeriod;			// 0 while stopped
+static uint64_t halWdtAt;
+
+void hal_wdt_enable(int8_t timeout)
+{
+	// WDTO_15MS..WDTO_8S: 2K << n cycles of the 128 kHz oscillator
+	halWdtPeriod = (timeout < 0) ? 0 : (uint64_t)(2048UL << timeout) * HAL_F_CPU / 128000;
+	halWdtAt = halCycles + halWdtPeriod;
+}
+
+void hal_wdt_reset(void)
+{
+	halWdtAt = halCycles + halWdtPeriod;
+}
+
+static uint64_t hal_next_event(void)
+{
+	uint64_t next = hal_timer_next(&halTimer1);
+	uint64_t t3 = hal_timer_next(&halTimer3);
+	if (t3 < next) { next = t3; }
+	if ((halAdcsra & (1 << ADIE)) && halAdcDone < next) { next = halAdcDone; }
+	return next;
+}
+
+static void hal_advance_to(uint64_t cycle)
+{
+	if (cycle > halCycles) { halCycles = cycle; }
+	if (halWdtPeriod && halCycles >= halWdtAt) {
+		MCUSR |= (1 << WDRF);
+		++halWdtResets;
+		sim_end();
+	}
+	hal_sync();
+	sim_tick();
+	hal_dispatch();
+	halNextSync = hal_next_event();
+	if (halNextSync > halCycles + HAL_CYCLES_PER_MS) { halNextSync = halCycles + HAL_CYCLES_PER_MS; }
+}
+
+void hal_delay_cycles(uint32_t cycles)
+{
+	hal_advance_to(halCycles + cycles);
+}
+
+void hal_nop(void)
+{
+	uint8_t e = PORTD & 0x80;
+	if (e && !halLcdE) { hal_lcd_latch(PORTD & 0x40, PORTC); }
+	halLcdE = e;
+
+	halCycles += HAL_NOP_CYCLES;
+	if (halCycles >= halNextSync) { hal_advance_to(halCycles); }
+}
+
+void hal_sleep(void)
+{
+	uint64_t next;
+	uint32_t served = halServed;
+
+	if (!(SREG & 0x80)) { sim_end(); }		// nothing can wake the part
+	while (halServed == served) {
+		next = hal_next_event();
+		if (next < halCycles) { next = halCycles; }
+		if (next > halCycles + HAL_SLEEP_STEP) { next = halCycles + HAL_SLEEP_STEP; }
+		hal_advance_to(next);
+	}
+}
@@ -0,0 +1,86 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Register-level hardware abstraction for the host (Linux) build.
+// The shim headers in host/avr and host/util replace avr-libc: plain output
+// registers are ordinary variables, while registers whose value depends on
+// the outside world (PINx, ADC, UDRn, UCSRnA, TCNTn) are read through the
+// hal_ functions below. Time is a virtual CPU cycle counter at F_CPU that
+// advances on every asm("nop") and jumps ahead on sleep_mode().
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+#define HAL_F_CPU 8000000UL
+#define HAL_NOP_CYCLES 10				// one delay_ms() loop iteration (775 per ms)
+#define HAL_CYCLES_PER_MS (HAL_F_CPU / 1000)
+
+// Interrupt sources in AVR vector priority order
+enum {
+	HAL_IRQ_WDT,
+	HAL_IRQ_TIMER1_COMPA,
+	HAL_IRQ_TIMER1_COMPB,
+	HAL_IRQ_TIMER1_OVF,
+	HAL_IRQ_SPI_STC,
+	HAL_IRQ_USART0_RX,
+	HAL_IRQ_ADC,
+	HAL_IRQ_USART1_RX,
+	HAL_IRQ_TIMER3_COMPA,
+	HAL_IRQ_TIMER3_OVF,
+	HAL_IRQ_COUNT
+};
+
+// Virtual time
+extern uint64_t halCycles;
+void hal_nop(void);
+void hal_delay_cycles(uint32_t cycles);
+void hal_sleep(void);
+
+// Register access
+uint8_t hal_pin(uint8_t port);
+uint16_t hal_adc(void);
+volatile uint8_t* hal_adcsra(void);
+volatile uint8_t* hal_udr(uint8_t n);
+volatile uint8_t* hal_ucsra(uint8_t n);
+volatile uint16_t* hal_tcnt(uint8_t n);
+volatile uint8_t* hal_tifr(uint8_t n);
+void hal_sei(void);
+void hal_cli(void);
+void hal_isr_enter(const char* attrs);
+void hal_raise(uint8_t irq);
+void hal_wdt_enable(int8_t timeout);	// WDTO_ code, -1 to stop it
+void hal_wdt_reset(void);
+extern uint32_t halWdtResets;
+
+// Valve drive: cycles the OC1A pin (PD5) was driven, high or PWM
+extern uint64_t halDriveCycles;
+extern uint64_t halSensorCycles;		// cycles the sensor supply (PD4) was on
+
+// EEPROM image, 4 KB
+#define HAL_EEPROM_SIZE 4096
+extern uint8_t halEeprom[HAL_EEPROM_SIZE];
+extern uint32_t halEepromWrites;
+
+// Outside world, driven by the simulator
+extern uint16_t halAnalog[8];			// volts at ADC0..7 as 10-bit counts
+extern uint8_t halSensorChannels;		// ADC channels fed from the sensor supply
+extern char halKey;						// keypad key held down, '\0' for none
+int hal_usart_rx_push(uint8_t n, uint8_t byte);
+
+// LCD model (HD44780, decoded from PORTC/PORTD while E is high)
+extern char halLcd[2][40];
+extern uint8_t halLcdShift;
+extern uint32_t halLcdOps;
+extern uint32_t halLcdVersion;			// bumps whenever the visible text changes
+void hal_lcd_visible(char out[2][17]);
+
+// Hooks implemented by the simulator
+void sim_usart_tx(uint8_t n, uint8_t byte);
+void sim_tick(void);					// called whenever virtual time moves
+void sim_end(void);						// called when the run is over, must not return
+
+#endif //HAL_H
@@ -0,0 +1,317 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host simulator: boots the firmware against hal.c and runs it on virtual
+// time. The plant is a simple model: the soil dries at a steady rate and
+// water flows while the zone valve (PD1) is open and the valve drive (OC1A)
+// is on, a fixed amount per 100 ms. With "soak" set the water first sits on
+// the surface and reaches the probe over that time constant, so the firmware's
+// closed loop sees the lag of real soil. The light sensor follows a 12 h day.
+// Both sensors hang off the switched sensor supply and read 0 while it is off.
+// USART output goes to stdout.
+//
+//   leaf_sim [-t 3d] [-s script] [-e eeprom.bin] [-l] [-q]
+//
+//   -t  how long to run (s, m, h or d suffix; default 1d)
+//   -s  scenario script, one "<time> <command> [args]" per line:
+//         joy up|down|left|right|center    hold the joystick
+//         tap up|down|left|right           hold for 300 ms (one UI tick), then center
+//         key <c>|none                     hold a keypad key
+//         press <c>                        hold a key for 300 ms
+//         adc <ch> <count>                 pin an analog input
+//         rx <usart> <text>                send text to a USART
+//         profile <slot> <day> <freq> <ms> <sun> [pulse ms]   seed EEPROM (time 0 only)
+//         dry <counts per hour>            soil drying rate
+//         flow <counts>                    moisture added per 100 ms of water
+//         soak <seconds>                   time for water to reach the probe (default 0)
+//         lcd                              print the display
+//         end                              stop the run here
+//   -e  EEPROM image, loaded if present and written back at the end
+//   -l  print the display whenever it changes
+//   -q  no USART output
+
+#include <avr/io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_MAX_EVENTS 256
+#define SIM_HOLD_MS 300
+#define SIM_CENTER 512
+#define SIM_MS_CH 6
+#define SIM_SUN_CH 7
+#define SIM_VALVE (1 << PD1)
+#define SIM_STEP_MS 10
+
+typedef struct SimEvent {
+	uint64_t ms;
+	char cmd[16];
+	char arg[96];
+} SimEvent;
+
+int firmware_main(void);
+
+static SimEvent simEvents[SIM_MAX_EVENTS];
+static unsigned simCount;
+static unsigned simNext;
+
+static uint64_t simEndMs = 24ULL * 3600 * 1000;
+static uint64_t simMs;					// last millisecond the model ran
+static uint64_t simHoldUntil;			// joystick / key auto release
+static const char* simEepromFile;
+static uint8_t simLogLcd;
+static uint8_t simQuiet;
+static uint32_t simLcdSeen;
+static uint64_t simLcdAt;				// when the display last changed
+static clock_t simStart;
+
+// Plant model, all in ADC counts
+static double simMoisture = 700;
+static double simDryPerHour = 10;
+static double simFlow = 250;
+static double simSoak;					// s, 0 = water reaches the probe at once
+static double simSurface;				// water not yet at the probe
+static uint8_t simPinned[8];
+
+// Report
+static uint64_t simDriveSeen;			// halDriveCycles already turned into water
+static double simWaterMs;
+static uint32_t simValveOpens;
+static uint8_t simValveWas;
+static double simMoistMin = 1023;
+static double simMoistMax = 0;
+
+static uint64_t sim_parse_time(const char* s)
+{
+	char* end;
+	double v = strtod(s, &end);
+	if (!strcmp(end, "ms")) { return (uint64_t)v; }
+	if (!strcmp(end, "m")) { return (uint64_t)(v * 60000); }
+	if (!strcmp(end, "h")) { return (uint64_t)(v * 3600000); }
+	if (!strcmp(end, "d")) { return (uint64_t)(v * 86400000); }
+	return (uint64_t)(v * 1000);
+}
+
+static void sim_print_lcd(void)
+{
+	char rows[2][17];
+	hal_lcd_visible(rows);
+	fprintf(stderr, "[%8.1f s] |%s|%s|\n", halCycles / (double)HAL_F_CPU, rows[0], rows[1]);
+}
+
+static void sim_joystick(const char* dir)
+{
+	halAnalog[4] = SIM_CENTER;
+	halAnalog[5] = SIM_CENTER;
+	if (!strcmp(dir, "up"))    { halAnalog[4] = 0; }
+	if (!strcmp(dir, "down"))  { halAnalog[4] = 1023; }
+	if (!strcmp(dir, "left"))  { halAnalog[5] = 0; }
+	if (!strcmp(dir, "right")) { halAnalog[5] = 1023; }
+}
+
+static void sim_seed_profile(const char* arg)
+{
+	unsigned slot, day, freq, ms, sun, pulse = 0;
+	uint8_t* p;
+	if (sscanf(arg, "%u %u %u %u %u %u", &slot, &day, &freq, &ms, &sun, &pulse) < 5 || slot < 1 || slot > 4) {
+		fprintf(stderr, "sim: bad profile '%s'\n", arg);
+		return;
+	}
+	// PlantProfile in profile.h: day, frequency, moisture, sun; 6 bytes from
+	// address 1, and the pulse in a table of 2 bytes from address 25
+	p = &halEeprom[1 + (slot - 1) * 6];
+	p[0] = day;
+	p[1] = freq;
+	p[2] = ms & 0xFF;
+	p[3] = ms >> 8;
+	p[4] = sun & 0xFF;
+	p[5] = sun >> 8;
+	p = &halEeprom[25 + (slot - 1) * 2];
+	p[0] = pulse & 0xFF;
+	p[1] = pulse >> 8;
+}
+
+static void sim_run_event(const SimEvent* e)
+{
+	unsigned ch, n;
+	double v;
+	const char* s;
+
+	if (!strcmp(e->cmd, "joy")) { sim_joystick(e->arg); }
+	else if (!strcmp(e->cmd, "tap")) { sim_joystick(e->arg); simHoldUntil = simMs + SIM_HOLD_MS; }
+	else if (!strcmp(e->cmd, "key")) { halKey = strcmp(e->arg, "none") ? e->arg[0] : '\0'; }
+	else if (!strcmp(e->cmd, "press")) { halKey = e->arg[0]; simHoldUntil = simMs + SIM_HOLD_MS; }
+	else if (!strcmp(e->cmd, "adc") && sscanf(e->arg, "%u %lf", &ch, &v) == 2 && ch < 8) {
+		halAnalog[ch] = (uint16_t)v;
+		simPinned[ch] = 1;
+		if (ch == SIM_MS_CH) { simMoisture = v; simPinned[ch] = 0; }
+	}
+	else if (!strcmp(e->cmd, "rx") && sscanf(e->arg, "%u", &n) == 1) {
+		s = strchr(e->arg, ' ');
+		for (s = s ? s + 1 : ""; *s; ++s) { hal_usart_rx_push(n, *s); }
+	}
+	else if (!strcmp(e->cmd, "profile")) { sim_seed_profile(e->arg); }
+	else if (!strcmp(e->cmd, "dry")) { simDryPerHour = atof(e->arg); }
+	else if (!strcmp(e->cmd, "flow")) { simFlow = atof(e->arg); }
+	else if (!strcmp(e->cmd, "soak")) { simSoak = atof(e->arg); }
+	else if (!strcmp(e->cmd, "lcd")) { sim_print_lcd(); }
+	else if (!strcmp(e->cmd, "end")) { sim_end(); }
+	else { fprintf(stderr, "sim: unknown command '%s'\n", e->cmd); }
+}
+
+static void sim_load_script(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char line[160];
+	char when[32];
+	SimEvent* e;
+	size_t n;
+	int used;
+
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f) && simCount < SIM_MAX_EVENTS) {
+		line[strcspn(line, "#\r\n")] = '\0';
+		e = &simEvents[simCount];
+		if (sscanf(line, "%31s %15s %n", when, e->cmd, &used) < 2) { continue; }
+		e->ms = sim_parse_time(when);
+		snprintf(e->arg, sizeof(e->arg), "%s", line + used);
+		for (n = strlen(e->arg); n && (e->arg[n - 1] == ' ' || e->arg[n - 1] == '\t'); --n) {
+			e->arg[n - 1] = '\0';
+		}
+		++simCount;
+	}
+	fclose(f);
+}
+
+// Moves the plant and the sun forward to the current virtual millisecond
+static void sim_model(uint64_t now)
+{
+	double hour, drive, seep;
+	uint8_t valve;
+
+	while (simMs + SIM_STEP_MS <= now) {
+		simMs += SIM_STEP_MS;
+		valve = (PORTD & SIM_VALVE) != 0;
+		drive = (double)(halDriveCycles - simDriveSeen) / HAL_CYCLES_PER_MS;
+		simDriveSeen = halDriveCycles;
+		simMoisture -= simDryPerHour * SIM_STEP_MS / 3600000.0;
+		if (valve && !simValveWas) { ++simValveOpens; }
+		if ((valve || simValveWas) && drive > 0) {
+			simSurface += simFlow * drive / 100;
+			simWaterMs += drive;
+		}
+		seep = simSoak > 0 ? simSurface * SIM_STEP_MS / (simSoak * 1000) : simSurface;
+		if (seep > simSurface) { seep = simSurface; }
+		simSurface -= seep;
+		simMoisture += seep;
+		simValveWas = valve;
+		if (simMoisture < 0) { simMoisture = 0; }
+		if (simMoisture > 1023) { simMoisture = 1023; }
+		if (simMoisture < simMoistMin) { simMoistMin = simMoisture; }
+		if (simMoisture > simMoistMax) { simMoistMax = simMoisture; }
+	}
+	if (!simPinned[SIM_MS_CH]) { halAnalog[SIM_MS_CH] = (uint16_t)simMoisture; }
+	if (!simPinned[SIM_SUN_CH]) {
+		hour = ((now / 1000) % 86400) / 3600.0 + 8;		// the run starts at 08:00
+		if (hour >= 24) { hour -= 24; }
+		halAnalog[SIM_SUN_CH] = (hour >= 6 && hour < 18) ? 800 : 100;
+	}
+}
+
+void sim_tick(void)
+{
+	uint64_t now = halCycles / HAL_CYCLES_PER_MS;
+
+	sim_model(now);
+	if (simHoldUntil && now >= simHoldUntil) {
+		simHoldUntil = 0;
+		sim_joystick("center");
+		halKey = '\0';
+	}
+	while (simNext < simCount && simEvents[simNext].ms <= now) {
+		sim_run_event(&simEvents[simNext++]);
+	}
+	// print once the display has settled, not once per character
+	if (halLcdVersion != simLcdSeen) {
+		simLcdSeen = halLcdVersion;
+		simLcdAt = now + 1;
+	}
+	else if (simLcdAt && now > simLcdAt + 20) {
+		simLcdAt = 0;
+		if (simLogLcd) { sim_print_lcd(); }
+	}
+	if (now >= simEndMs) { sim_end(); }
+}
+
+void sim_usart_tx(uint8_t n, uint8_t byte)
+{
+	(void)n;
+	if (!simQuiet) { putchar(byte); }
+}
+
+void sim_end(void)
+{
+	double wall = (double)(clock() - simStart) / CLOCKS_PER_SEC;
+	double simulated = halCycles / (double)HAL_F_CPU;
+	FILE* f;
+
+	fflush(stdout);
+	sim_print_lcd();
+	fprintf(stderr, "simulated %.1f h in %.2f s (%.0fx)\n", simulated / 3600, wall, wall > 0 ? simulated / wall : 0);
+	fprintf(stderr, "valve opened %u times, water %.0f ms; moisture %.0f..%.0f, now %.0f\n",
+		simValveOpens, simWaterMs, simMoistMin, simMoistMax, simMoisture);
+	fprintf(stderr, "eeprom writes %u, lcd bus writes %u\n", halEepromWrites, halLcdOps);
+	fprintf(stderr, "sensor supply on %.2f%% of the time\n", halCycles ? 100.0 * halSensorCycles / halCycles : 0);
+	if (halWdtResets) { fprintf(stderr, "watchdog reset at %.3f s\n", simulated); }
+
+	if (simEepromFile && (f = fopen(simEepromFile, "wb"))) {
+		fwrite(halEeprom, 1, sizeof(halEeprom), f);
+		fclose(f);
+	}
+	exit(0);
+}
+
+int main(int argc, char** argv)
+{
+	FILE* f;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-t") && i + 1 < argc) { simEndMs = sim_parse_time(argv[++i]); }
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc) { sim_load_script(argv[++i]); }
+		else if (!strcmp(argv[i], "-e") && i + 1 < argc) { simEepromFile = argv[++i]; }
+		else if (!strcmp(argv[i], "-l")) { simLogLcd = 1; }
+		else if (!strcmp(argv[i], "-q")) { simQuiet = 1; }
+		else {
+			fprintf(stderr, "usage: %s [-t 1d] [-s script] [-e eeprom.bin] [-l] [-q]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	memset(halEeprom, 0xFF, sizeof(halEeprom));
+	memset(halLcd, ' ', sizeof(halLcd));
+	if (simEepromFile && (f = fopen(simEepromFile, "rb"))) {
+		if (fread(halEeprom, 1, sizeof(halEeprom), f) != sizeof(halEeprom)) {
+			fprintf(stderr, "sim: short EEPROM image %s\n", simEepromFile);
+		}
+		fclose(f);
+	}
+	sim_joystick("center");
+	halSensorChannels = (1 << SIM_MS_CH) | (1 << SIM_SUN_CH);
+	// time 0 events (profile seeds) happen before the part comes out of reset
+	while (simNext < simCount && simEvents[simNext].ms == 0) {
+		sim_run_event(&simEvents[simNext++]);
+	}
+	sim_model(0);
+
+	simStart = clock();
+	firmware_main();
+	sim_end();
+	return 0;
+}
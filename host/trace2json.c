@@ -0,0 +1,186 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Converts a trace dump (headers/trace.h, console command 'T') into Chrome
+// trace-event JSON, for chrome://tracing or ui.perfetto.dev. The input is
+// whatever the console received, e.g. a serial capture or leaf_sim's stdout;
+// the last complete dump in it is converted.
+//
+//   trace2json [dump.bin] > trace.json
+//
+// Each kind of event gets its own row: the tick ISR, the tasks, LCD
+// drawing, screens, EEPROM writes, the valve and waterings. Timestamps are
+// unwrapped from the 16-bit record time, so the first record is at 0 us.
+// An end whose begin was already overwritten in the ring is dropped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAX_INPUT (1 << 20)
+#define TRACE_US_PER_STEP 8				// TCNT1 step at F_CPU / 64
+
+// Record time: ms << 7 | TCNT1, TCNT1 counting 0..SCHED_TICK_TOP (125)
+#define TRACE_US(t) (((t) >> 7) * 1000 + ((t) & 0x7F) * TRACE_US_PER_STEP)
+
+// Mirrors the TRACE_ types in headers/trace.h
+enum {
+	TRACE_NONE,
+	TRACE_TASK_BEGIN,
+	TRACE_TASK_END,
+	TRACE_ISR_BEGIN,
+	TRACE_ISR_END,
+	TRACE_STATE,
+	TRACE_LCD_BEGIN,
+	TRACE_LCD_END,
+	TRACE_EEPROM,
+	TRACE_VALVE_ON,
+	TRACE_VALVE_OFF,
+	TRACE_WATER_BEGIN,
+	TRACE_WATER_END
+};
+
+// One row per kind of event
+enum { ROW_ISR, ROW_TASKS, ROW_LCD, ROW_SCREEN, ROW_EEPROM, ROW_VALVE, ROW_WATER, ROWS };
+
+static const char* const traceRows[ROWS] = {
+	"TIMER1_OVF", "tasks", "LCD", "screen", "EEPROM", "valve", "watering"
+};
+static const char* const traceEeWriters[] = { "profile", "calibration", "history" };
+static const char* const traceLcdSpans[] = { "screen", "fields", "scroll" };
+
+static int traceOpen[ROWS];				// spans begun and not ended
+static int traceFirst = 1;
+
+static void trace_event(const char* name, char ph, int row, double us, const char* args)
+{
+	printf("%s\n  {\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.0f", traceFirst ? "" : ",", name, ph, row, us);
+	if (ph == 'i') { printf(",\"s\":\"t\""); }
+	if (args) { printf(",\"args\":{%s}", args); }
+	printf("}");
+	traceFirst = 0;
+}
+
+static void trace_begin(const char* name, int row, double us, const char* args)
+{
+	++traceOpen[row];
+	trace_event(name, 'B', row, us, args);
+}
+
+static void trace_end(const char* name, int row, double us)
+{
+	if (!traceOpen[row]) { return; }
+	--traceOpen[row];
+	trace_event(name, 'E', row, us, 0);
+}
+
+int main(int argc, char** argv)
+{
+	static unsigned char buf[TRACE_MAX_INPUT];
+	FILE* f = stdin;
+	size_t len, i, at = 0;
+	unsigned n, k, type, arg, used = 0;
+	unsigned short time, last = 0;
+	long long units = 0, base = 0;
+	int found = 0, started = 0;
+	char name[32], args[48];
+	double us;
+
+	if (argc > 2 || (argc == 2 && !(f = fopen(argv[1], "rb")))) {
+		if (argc == 2) { perror(argv[1]); }
+		else { fprintf(stderr, "usage: %s [dump.bin] > trace.json\n", argv[0]); }
+		return 2;
+	}
+	len = fread(buf, 1, sizeof(buf), f);
+	if (f != stdin) { fclose(f); }
+
+	// "TRC" <records> then 4 bytes per record
+	for (i = 0; i + 4 <= len; ++i) {
+		if (!memcmp(buf + i, "TRC", 3) && i + 4 + buf[i + 3] * 4u <= len && buf[i + 3]) {
+			at = i;
+			found = 1;
+		}
+	}
+	if (!found) {
+		fprintf(stderr, "trace2json: no complete trace dump in the input\n");
+		return 1;
+	}
+	n = buf[at + 3];
+
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (k = 0; k < ROWS; ++k) {
+		snprintf(args, sizeof(args), "\"name\":\"%s\"", traceRows[k]);
+		trace_event("thread_name", 'M', k, 0, args);
+	}
+	for (k = 0; k < n; ++k) {
+		const unsigned char* r = buf + at + 4 + k * 4;
+		time = r[0] | (r[1] << 8);
+		type = r[2];
+		arg = r[3];
+		if (type == TRACE_NONE) { continue; }
+		// records are in time order, less than half a wrap apart
+		if (started) { units += (short)(time - last); }
+		else {
+			units = time;
+			base = TRACE_US(units);
+		}
+		last = time;
+		started = 1;
+		++used;
+		us = (double)(TRACE_US(units) - base);
+
+		switch (type) {
+			case TRACE_TASK_BEGIN:
+			case TRACE_TASK_END:
+				snprintf(name, sizeof(name), "task %u", arg);
+				if (type == TRACE_TASK_BEGIN) { trace_begin(name, ROW_TASKS, us, 0); }
+				else { trace_end(name, ROW_TASKS, us); }
+				break;
+			case TRACE_ISR_BEGIN:
+				trace_begin("tick", ROW_ISR, us, 0);
+				break;
+			case TRACE_ISR_END:
+				trace_end("tick", ROW_ISR, us);
+				break;
+			case TRACE_STATE:
+				snprintf(name, sizeof(name), "screen %u", arg);
+				trace_event(name, 'i', ROW_SCREEN, us, 0);
+				break;
+			case TRACE_LCD_BEGIN:
+				trace_begin(arg < 3 ? traceLcdSpans[arg] : "?", ROW_LCD, us, 0);
+				break;
+			case TRACE_LCD_END:
+				trace_end(arg < 3 ? traceLcdSpans[arg] : "?", ROW_LCD, us);
+				break;
+			case TRACE_EEPROM:
+				snprintf(args, sizeof(args), "\"writer\":\"%s\"", arg < 3 ? traceEeWriters[arg] : "?");
+				trace_event("write", 'i', ROW_EEPROM, us, args);
+				break;
+			case TRACE_VALVE_ON:
+				trace_begin("open", ROW_VALVE, us, 0);
+				break;
+			case TRACE_VALVE_OFF:
+				trace_end("open", ROW_VALVE, us);
+				break;
+			case TRACE_WATER_BEGIN:
+				snprintf(args, sizeof(args), "\"zones\":%u", arg);
+				trace_begin("watering", ROW_WATER, us, args);
+				break;
+			case TRACE_WATER_END:
+				trace_end("watering", ROW_WATER, us);
+				// ZONE_EV_LIMIT or ZONE_EV_DONE
+				snprintf(args, sizeof(args), "\"reason\":\"%s\"", arg == 2 ? "limit" : "done");
+				trace_event("stop", 'i', ROW_WATER, us, args);
+				break;
+			default:
+				snprintf(args, sizeof(args), "\"type\":%u,\"arg\":%u", type, arg);
+				trace_event("unknown", 'i', ROW_SCREEN, us, args);
+				break;
+		}
+	}
+	printf("\n]}\n");
+	fprintf(stderr, "trace2json: %u events over %.1f ms\n", used, (TRACE_US(units) - base) / 1000.0);
+	return 0;
+}
@@ -0,0 +1,21 @@
+// Permission to copy is granted provided that this header remains intact.
+// This software is provided with no warranties.
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Host stand-in for <util/atomic.h>.
+
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>
+
+static inline uint8_t hal_atomic_save(void) { uint8_t s = SREG; hal_cli(); return s; }
+static inline void hal_atomic_restore(const uint8_t* s) { if (*s & 0x80) { hal_sei(); } }
+static inline void hal_atomic_on(const uint8_t* s) { (void)s; hal_sei(); }
+
+#define ATOMIC_RESTORESTATE uint8_t sreg_save __attribute__((__cleanup__(hal_atomic_restore))) = hal_atomic_save()
+#define ATOMIC_FORCEON uint8_t sreg_save __attribute__((__cleanup__(hal_atomic_on))) = hal_atomic_save()
+#define ATOMIC_BLOCK(type) for (type, hal_atomic_once = 1; hal_atomic_once; hal_atomic_once = 0)
+
+#endif //HOST_UTIL_ATOMIC_H
@@ -1,12 +1,27 @@
 #include <avr/io.h>
-#include <util/atomic.h>
 #include <avr/eeprom.h>
-#include <math.h>
+#include <avr/sleep.h>
+#include "board.h"
 #include "spi.h"
 #include "keypad.h"
+#include "adc.h"
 #include "scheduler.h"
 #include "io.h"
 #include "usart.h"
+#include "profile.h"
+#include "zones.h"
+#include "warm.h"
+#include "boot.h"
+#include "history.h"
+#include "trace.h"
+#include "update.h"
+#include "fixmap.h"
+#include "calib.h"
+#include "fmt.h"
+#include "uitext.h"
+#include "glyph.h"
+#include "menu.h"
+#include "display.h"
 
 /* ----------  DEFINITIONS  ---------- */
 
@@ -17,28 +32,12 @@
 #define UP LR < 150
 #define PROFILER PIND & 0x02
 #define WELCOMER !(PIND & 0x02)
-#define VALID GetKeypadKey() != 'A' && GetKeypadKey() != 'B' && GetKeypadKey() != 'C' && GetKeypadKey() != 'D' && GetKeypadKey() != '\0'
-#define input1234 GetKeypadKey() == '1' || GetKeypadKey() == '2' || GetKeypadKey() == '3' || GetKeypadKey() == '4'
-#define OK_TO_WATER (plant1.dayTimeWaterOK == 0 && SUN_reading < plant1.sunLevel) && day >= frequency && MS_reading < plant1.moisture
 
 #define ONE 0x14
 #define TWO 0xB3
 #define THREE 0xB6
 #define FOUR 0xD4
 
-#define SLOT1 1
-#define SLOT2 7
-#define SLOT3 13
-#define SLOT4 19
-
-/* ----------  STRUCTURES  ---------- */
-typedef struct PlantProfile {
-	uchar dayTimeWaterOK;
-	uchar waterFrequency;
-	unsigned short moisture;
-	unsigned short sunLevel;
-} PlantProfile;
-
 /* -----------  GLOBALS  ----------- */
 struct PlantProfile plant1;
 unsigned short LR = 0;
@@ -46,27 +45,15 @@ unsigned short UD = 0;
 unsigned short MS_reading;
 unsigned short SUN_reading;
 uchar enableScaler;
+uchar fbuf[FMT_U16_MAX + 1];
 
 /* -----------  CONSTANTS  ----------- */
-const uchar *profileQs[] = {
-	"OK to water in  day?",
-	"# of day betweenwatering?",
-	"Moisture Sense: 1,2,3,4?:"
-};
-
-const char *verbose[] = {
-	"Yes",
-	"No",
-	" "
-};
-
-const uchar *answer = " ";
+const char *answer = txtBlank;
 
 /* ----------  SS VARIABLES  ---------- */
 uchar stored;
 uchar memSlot;
 uchar num;
-uchar control;
 uchar gotit;
 
 
@@ -77,137 +64,88 @@ void ADC_init() {
 	ADCSRA |= (1 << ADEN) | (1 << ADSC) | (1 << ADATE);
 }
 
-void setADCPin(unsigned char pinNum) {
-	ADMUX = (pinNum <= 0x07) ? pinNum: ADMUX;
-	static unsigned char i = 0;
-	for (i = 0; i < 30; ++i) { asm("nop"); }
-}
-
 void readJoystick() {
-	ADMUX = (4 <= 0x07) ? 4: ADMUX;
-	static unsigned char i = 0;
-	for (i = 0; i < 30; ++i) { asm("nop"); }
-	LR = ADC;
-	
-	ADMUX = (5 <= 0x07) ? 5: ADMUX;
-	i = 0;
-	for (i = 0; i < 30; ++i) { asm("nop"); }
-	UD = ADC;
-}
-
-void LCD_clearBottomRow() {
-	LCD_DisplayString(17, "                ");
+#if DISPLAY_REMOTE
+	Display_Poll();					// the keypad's state comes along
+#else
+	LR = ADC_Read(JOY_LR_CHANNEL);
+	UD = ADC_Read(JOY_UD_CHANNEL);
+#endif
 }
 
 void transmit_data(uchar data) {
 	uchar i;
-	for (i = 0; i < 8; ++i) {
-		PORTA = 0x08;
-		PORTA |= ((data >> i) & 0x01);
-		PORTA |= 0x04;
+	for (i = 0; i < 8; ++i, data >>= 1) {
+		SHIFT_PORT = (1 << SHIFT_SRCLR);
+		if (data & 0x01) { SET_BIT(SHIFT_PORT, SHIFT_SER); }
+		SET_BIT(SHIFT_PORT, SHIFT_SRCLK);
 	}
-	PORTA |= 0x02;
-	PORTA = 0x00;
+	SET_BIT(SHIFT_PORT, SHIFT_RCLK);
+	SHIFT_PORT = 0x00;
 }
 
 void saveMS(unsigned short m, uchar slot) {
-	if (slot == SLOT1) {slot = SLOT1;}
-	if (slot == SLOT2) {slot = SLOT2;}
-	if (slot == SLOT3) {slot = SLOT3;}
-	if (slot == SLOT4) {slot = SLOT4;}
-	eeprom_write_word(slot+2, m);
+	if (!Profile_IsSlot(slot)) { return; }
+	PlantProfile p = *Profile_Get(slot);
+	p.moisture = m;
+	Profile_Put(&p, slot);
+	Zone_Refresh(slot);
 }
 
 void saveSun(unsigned short s, uchar slot) {
-	if (slot == SLOT1) {slot = SLOT1;}
-	if (slot == SLOT2) {slot = SLOT2;}
-	if (slot == SLOT3) {slot = SLOT3;}
-	if (slot == SLOT4) {slot = SLOT4;}
-	eeprom_write_word(slot+4, s);
+	if (!Profile_IsSlot(slot)) { return; }
+	PlantProfile p = *Profile_Get(slot);
+	p.sunLevel = s;
+	Profile_Put(&p, slot);
+	Zone_Refresh(slot);
 }
 
 void savePlantProfile(PlantProfile p, uchar slot) {
-	if (slot == SLOT1) {slot = SLOT1;}
-	if (slot == SLOT2) {slot = SLOT2;}
-	if (slot == SLOT3) {slot = SLOT3;}
-	if (slot == SLOT4) {slot = SLOT4;}
-	eeprom_write_byte(slot, p.dayTimeWaterOK);
-	eeprom_write_byte(slot+1, p.waterFrequency);
-	eeprom_write_word(slot+2, p.moisture);
-	eeprom_write_word(slot+4, p.sunLevel);
+	Profile_Put(&p, slot);
+	Zone_Refresh(slot);
 }
 
 void retrievePlantProfile(uchar slot) {
-	if (slot == SLOT1) {slot = SLOT1;}
-	if (slot == SLOT2) {slot = SLOT2;}
-	if (slot == SLOT3) {slot = SLOT3;}
-	if (slot == SLOT4) {slot = SLOT4;}
-	plant1.dayTimeWaterOK = eeprom_read_byte(slot);
-	plant1.waterFrequency = eeprom_read_byte(slot+1);
-	plant1.moisture = eeprom_read_word(slot+2);
-	plant1.sunLevel = eeprom_read_word(slot+4);
+	if (!Profile_IsSlot(slot)) { return; }
+	plant1 = *Profile_Get(slot);
+	Zone_Bind(0, slot);
 }
 
-void readMoisture() {
-	ADMUX = (6 <= 0x07) ? 6: ADMUX;
-	static unsigned char i = 0;
-	for (i = 0; i < 30; ++i) { asm("nop"); }
-	MS_reading = ADC;
-}
+// Bars of calibrated readings, 0..CAL_FULL over BAR_CELLS cells; the live
+// screens show the bar alone, so an update is only the cells that changed
+#define BAR_CELLS 8
+#define BAR_CELLS_WIDE 14
 
-void readSun() {
-	ADMUX = (7 <= 0x07) ? 7: ADMUX;
-	static unsigned char i = 0;
-	for (i = 0; i < 30; ++i) { asm("nop"); }
-	SUN_reading = ADC;
-}
+GlyphBar barTop;
+GlyphBar barBottom;
 
-double rounder(double d) {
-	return floor(d + 0.5);
-}
-
-double scaler(double x, double input_min, double input_max, double output_min, double output_max) {
-	double slope = 1.0 * (output_max - output_min) / (input_max - input_min);
-	double output = output_min + rounder(slope * (x - input_min));
-	return (unsigned short)output;
+void showBar(GlyphBar* bar, uchar pos, uchar cells, unsigned short x) {
+	if (x > CAL_FULL) { x = CAL_FULL; }
+	Glyph_Bar(bar, pos, cells, MAP_RANGE(x, 0, CAL_FULL, 0, cells * GLYPH_BAR_STEPS));
 }
 
 void convertToDec(uchar pos, unsigned short x) {
+	uchar buf[FMT_U16_MAX + 2];
 	if (enableScaler == 1) {
-		x = scaler(x, 0, 1024, 0, 100);
+		Fmt_U16(buf, CAL_PERCENT(x), 3, ' ', "%");
 	}
-	unsigned short thousands;
-	unsigned short hundreds;
-	unsigned short tens;
-	unsigned short ones;
-	
-	thousands = x / 1000;
-	LCD_Cursor(pos);
-	LCD_WriteData(thousands + '0');
-	x = x - (thousands * 1000);
-
-	hundreds = x / 100;
-	LCD_Cursor(pos+1);
-	LCD_WriteData(hundreds + '0');
-	x = x - (hundreds * 100);
-	
-	tens = x / 10;
-	LCD_Cursor(pos+2);
-	LCD_WriteData(tens + '0');
-	x = x - (tens * 10);
-	
-	ones = x / 1;
-	LCD_Cursor(pos+3);
-	LCD_WriteData(ones + '0');
-	x = x - (ones * 1);
+	else {
+		Fmt_U16(buf, x, 4, '0', 0);
+	}
+	LCD_DisplayString(pos, buf);
 }
 
 enum {
 	WELCOME,
 	SETTINGS,
-	MAIN1,
-	MAIN2,
-	MAIN3,
+	MENU_SET,
+	MENU_LOAD,
+	MENU_DATA,
+	MENU_GLANCE,
+	MENU_CALMS,
+	MENU_CALSUN,
+	MENU_CURVE,
+	MENU_DIAG,
 	GLANCE1,
 	GLANCE2,
 	TAKE_READING,
@@ -218,6 +156,7 @@ enum {
 	UPDATE_PROFILE,
 	Q1,
 	Q2,
+	Q2_2,
 	Q3_1,
 	Q3_2,
 	Q4_1,
@@ -232,685 +171,489 @@ enum {
 	SETTING2,
 	SETTING3,
 	SETTING4,
+	SETTING5,
+	DIAG,
+	CURVE_SENSOR,
+	CURVE_POINT,
+	CURVE_SAVE,
+	NUM_STATES
 } stater;
 
+/* ----------  SCREEN CALLBACKS  ---------- */
+
+const uchar slotCodes[] PROGMEM = { ONE, TWO, THREE, FOUR };
+unsigned short shownMS;
+unsigned short shownPeak;
+unsigned short pulseTenths;
+uchar lastKey;
+unsigned short shownSun;
+unsigned short shownRaw;
+uchar curveSensor;
+CalCurve curve;
+unsigned short curveRef;
+
+uchar readDirection() {
+#if DISPLAY_REMOTE
+	return Display_Dir();
+#else
+	if (UP) { return DIR_UP; }
+	if (DOWN) { return DIR_DOWN; }
+	if (LEFT) { return DIR_LEFT; }
+	if (RIGHT) { return DIR_RIGHT; }
+	return DIR_NONE;
+#endif
+}
 
-int ss(stater) {
-	switch(stater) {
-		case WELCOME:
-			if (DOWN) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case MAIN1:
-			if (DOWN && control == 0) {
-				LCD_ClearScreen();
-				control = 1;
-			}
-			else if (UP && control == 1) {
-				LCD_ClearScreen();
-				control = 0;
-			}
-			else if (DOWN && control == 1) {
-				LCD_ClearScreen();
-				control = 2;
-				stater = MAIN2;
-			}
-			if (control == 0 && RIGHT) {
-				LCD_ClearScreen();
-				stater = Q1;
-			}
-			if (control == 1 && RIGHT) {
-				LCD_ClearScreen();
-				stater = READFROM;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = SETTINGS;
-			}
-			break;
-			
-		case SETTINGS:
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = MAIN1;
-			}
-			else if (UP) {
-				LCD_ClearScreen();
-				enableScaler = 1;
-				break;
-			}
-			else if (DOWN) {
-				LCD_ClearScreen();
-				enableScaler = 0;
-			}
-			break;
-			
-		case MAIN2:
-			if (UP && control == 2) {
-				LCD_ClearScreen();
-				control = 1;
-				stater = MAIN1;
-			}
-			if (DOWN && control == 2) {
-				LCD_ClearScreen();
-				control = 3;
-			}
-			else if (UP && control == 3) {
-				LCD_ClearScreen();
-				control = 2;
-			}
-			else if (DOWN && control == 3) {
-				LCD_ClearScreen();
-				control = 4;
-				stater = MAIN3;
-			}
-			if (control == 2 && RIGHT) {
-				LCD_ClearScreen();
-				stater = TAKE_READING;
-			}
-			if (control == 3 && RIGHT) {
-				LCD_ClearScreen();
-				stater = GLANCE1;
-			}
-			break;
-			
-		case MAIN3:
-			if (UP && control == 4) {
-				LCD_ClearScreen();
-				control = 3;
-				stater = MAIN2;
-			}
-			if (UP && control == 5) {
-				LCD_ClearScreen();
-				control = 4;
-			}
-			if (control == 4 && RIGHT) {
-				LCD_ClearScreen();
-				stater = CALIB_MS;
-			}
-			if (control == 5 && RIGHT) {
-				LCD_ClearScreen();
-				stater = CALIB_SUN;
-			}
-			if (DOWN && control == 4) {
-				LCD_ClearScreen();
-				control = 5;
-			}
-			break;
-			
-		case GLANCE1:
-			if (UP || DOWN) {
-				LCD_ClearScreen();
-				stater = GLANCE2;
-			}
-			else if (LEFT) {
-				LCD_ClearScreen();
-				stater = MAIN2;
-			}
-			break;
-			
-		case GLANCE2:
-			if (UP || DOWN) {
-				LCD_ClearScreen();
-				stater = GLANCE1;
-			}
-			else if (LEFT) {
-				LCD_ClearScreen();
-				stater = MAIN2;
-			}
-			break;
-		
-		case TAKE_READING:
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = MAIN2;
-			}
-			break;
-			
-		case CALIB_SUN:
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = MAIN3;
-			}
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = CALIB_SUN2;
-			}
-			break;
-			
-		case CALIB_SUN2:
-			if (RIGHT) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = WRITE_SUN;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = CALIB_SUN;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case CALIB_MS:
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				control = 4;
-				stater = MAIN3;
-			}
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = CALIB_MS2;
-			}
-			break;
-			
-		case CALIB_MS2:
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = WRITE_MS;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = CALIB_MS;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case WRITE_MS:
-			control = 0;
-			stater = MAIN1;
-			break;
-			
-		case WRITE_SUN:
-			control = 0;
-			stater = MAIN1;
-			break;
-			
-		case UPDATE_PROFILE:
-			control = 0;
-			stater = MAIN1;
-			break;
-		
-		case READFROM:
-			if (RIGHT && gotit == 1) {
-				gotit = 0;
-				LCD_ClearScreen();
-				stater = RETRIEVE;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				control = 1;
-				stater = MAIN1;
-			}
-			break;
-			
-		case RETRIEVE:
-			stater = SETTING1;
-			break;
-		
-		case SETTING1:
-			if (UP) {
-				LCD_ClearScreen();
-				stater = SETTING4;
-			}
-			if (DOWN) {
-				LCD_ClearScreen();
-				stater = SETTING2;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case SETTING2:
-			if (UP) {
-				LCD_ClearScreen();
-				stater = SETTING1;
-			}
-			if (DOWN) {
-				LCD_ClearScreen();
-				stater = SETTING3;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
+uchar readKey() {
+#if DISPLAY_REMOTE
+	return Display_Key();
+#else
+	return GetKeypadKey();
+#endif
+}
 
-		case SETTING3:
-			if (UP) {
-				LCD_ClearScreen();
-				stater = SETTING2;
-			}
-			if (DOWN) {
-				LCD_ClearScreen();
-				stater = SETTING4;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case SETTING4:
-			if (UP) {
-				LCD_ClearScreen();
-				stater = SETTING3;
-			}
-			if (DOWN) {
-				LCD_ClearScreen();
-				stater = SETTING1;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case Q1:
-			if (RIGHT && gotit == 1) {
-				gotit = 0;
-				LCD_ClearScreen();
-				answer = " ";
-				stater = Q2;
-			}
-			if (LEFT || UP) {
-				LCD_ClearScreen();
-				answer = " ";
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case Q2:
-			if (RIGHT && gotit == 1) {
-				gotit = 0;
-				LCD_ClearScreen();
-				stater = Q3_1;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = Q1;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-		
-		case Q3_1:
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = Q3_2;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = Q2;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
+uchar keyHeld() {
+#if DISPLAY_REMOTE
+	return Display_Key() != '\0';
+#else
+	return Keypad_Any();
+#endif
+}
 
-		case Q3_2:
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = Q4_1;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = Q3_1;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case Q4_1:
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = Q4_2;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = Q3_1;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case Q4_2:
-			if (RIGHT) {
-				LCD_ClearScreen();
-				stater = CONFIRM;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = Q4_1;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case CONFIRM:
-			if (RIGHT && memSlot != 0) {
-				LCD_ClearScreen();
-				stater = WRITE;
-			}
-			if (LEFT) {
-				LCD_ClearScreen();
-				stater = Q4_2;
-			}
-			if (UP) {
-				LCD_ClearScreen();
-				control = 0;
-				stater = MAIN1;
-			}
-			break;
-			
-		case WRITE:
-			control = 0;
-			stater = MAIN1;
-			break;
-			
-		default:
-			control = 0;
-			stater = WELCOME;
-			break;
+void showSlot() {
+	if (Profile_IsSlot(memSlot)) {
+		transmit_data(pgm_read_byte(&slotCodes[memSlot - 1]));
 	}
-	
-	switch(stater) {
-		case WELCOME:
-			LCD_DisplayString(1, "   Welcome To   <Leaf of Faith> ");
-			break;
-			
-		case MAIN1:
-			if (control == 0) {
-				LCD_DisplayString(1, "> Set  Profile    Load Profile");
-			}
-			else if (control == 1) {
-				LCD_DisplayString(1, "  Set  Profile  > Load Profile");
-			}
-			break;
-			
-		case SETTINGS:
-			LCD_DisplayString(1, "Enable Scaler?");
-			if (enableScaler == 1) {
-				LCD_DisplayString(21, "< Yay >");
-			}
-			else if (enableScaler == 0) {
-				LCD_DisplayString(21, "< Nay >");
-			}
-			break;
-						
-		case MAIN2:
-			if (control == 2) {
-				LCD_DisplayString(1, "> Current Data    At A Glance");
-			}
-			else if (control == 3) {
-				LCD_DisplayString(1, "  Current Data  > At A Glance");
-			}
-			break;
+}
 
-		case MAIN3:
-			if (control == 4) {
-				LCD_DisplayString(1, "> Calibrate MS    Calibrate Sun");
-			}
-			else if (control == 5) {
-				LCD_DisplayString(1, "  Calibrate MS  > Calibrate Sun");
-			}
-			break;
+uchar readyGotit() {
+	return gotit == 1;
+}
 
-		case GLANCE1:
-			LCD_DisplayString(1, "Daytime h2O:");
-			LCD_DisplayString(17, "Frequency:");
-			(plant1.dayTimeWaterOK==1) ? LCD_DisplayString(14, "Yes") : LCD_DisplayString(14, "No");
-			convertToDec(28, plant1.waterFrequency);
-			break;
+uchar readySlot() {
+	return memSlot != 0;
+}
 
-		case GLANCE2:
-			LCD_DisplayString(1, "MS:");
-			LCD_DisplayString(17, "SL:");
-			convertToDec(4, plant1.moisture);
-			convertToDec(20, plant1.sunLevel);
-			break;
-			
-		case TAKE_READING:
-			LCD_DisplayString(1, "Moisture:");
-			LCD_DisplayString(17, "Sunlight:");
-			convertToDec(11, MS_reading);
-			convertToDec(27, SUN_reading);
-			break;
-			
-		case CALIB_SUN:
-			LCD_DisplayString(1, "1.Set Photo       Sensor    -->");
-			break;
-		
-		case CALIB_SUN2:
-			LCD_DisplayString(1, "2.Reading: ");
-			plant1.sunLevel = SUN_reading;
-			convertToDec(12, SUN_reading);
-			LCD_DisplayString(25, "SAVE -->");
-			break;
-			
-		case CALIB_MS:
-			LCD_DisplayString(1, "1.Place Moisture  Sensor    -->");
-			break;
-			
-		case CALIB_MS2:
-			LCD_DisplayString(1, "2.Reading: ");
-			plant1.moisture = MS_reading;
-			convertToDec(12, MS_reading);
-			LCD_DisplayString(25, "SAVE -->");
-			break;
-			
-		case READFROM:
-			LCD_DisplayString(1, "Source Mem Slot 1,2,3,4?:");
-			if (input1234) {
-				gotit = 1;
-				LCD_Cursor(27);
-				memSlot = GetKeypadKey() - '0';
-				LCD_WriteData(memSlot + '0');
-			}
-			break;
-			
-		case RETRIEVE:
-			retrievePlantProfile(memSlot);
-			if (memSlot == 1) {
-				num = ONE;
-			}
-			else if (memSlot == 2) {
-				num = TWO;
-			}
-			else if (memSlot == 3) {
-				num = THREE;
-			}
-			else if (memSlot == 4) {
-				num = FOUR;
-			}
-			transmit_data(num);
-			break;
-			
-		case SETTING1:
-			LCD_DisplayString(1, "Water During Day");
-			if (plant1.dayTimeWaterOK == 1) {
-				LCD_DisplayString(17, "Yes");
-			}
-			else if (plant1.dayTimeWaterOK == 0) {
-				LCD_DisplayString(17, "No");
-			}
-			break;
-			
-		case SETTING2:
-			LCD_DisplayString(1, "Water every");
-			LCD_Cursor(13);
-			LCD_WriteData(plant1.waterFrequency + '0');
-			LCD_DisplayString(17, "days");
-			break;
-			
-		case SETTING3:
-			LCD_DisplayString(1, "MS Threshold");
-			convertToDec(17, plant1.moisture);
-			break;
-			
-		case SETTING4:
-			LCD_DisplayString(1, "Sun Threshold");
-			convertToDec(17, plant1.sunLevel);
-			break;
-			
-		case Q1:
-			LCD_DisplayString(1, profileQs[0]);
-			LCD_DisplayString(22, answer);
-			if (GetKeypadKey() == 'A') {
-				answer = "Yes";
-				plant1.dayTimeWaterOK = 1;
-				gotit = 1;
-			}
-			else if (GetKeypadKey() == 'B') {
-				answer = "No ";
-				plant1.dayTimeWaterOK = 0;
-				gotit = 1;
-			}
-			else if (GetKeypadKey() == '*') {
-				answer = " ";
-			}
-			break;
-			
-		case Q2:
-			LCD_DisplayString(1, profileQs[1]);
-			if (VALID) {
-				/* for Demo: special key to set frequency to 1 min, can show reseting/watering */
-				if (GetKeypadKey() == '*') {
-					plant1.waterFrequency = 99;
-					LCD_Cursor(28);
-					LCD_WriteData(9 + '0');
-					gotit = 1;
-				}
-				else {
-					LCD_Cursor(28);
-					LCD_WriteData(GetKeypadKey());
-					plant1.waterFrequency = GetKeypadKey() - '0';
-					gotit = 1;
-				}
-			}
-			break;
-			
-		case Q3_1:
-			LCD_DisplayString(1, "1.Place Moisture  Sensor    -->");
-			break;
-		
-		case Q3_2:
-			LCD_DisplayString(1, "2.Reading: ");
-			plant1.moisture = MS_reading;
-			convertToDec(12, MS_reading);
-			LCD_DisplayString(25, "SAVE -->");
-			break;
-			
-		case Q4_1:
-			LCD_DisplayString(1, "3.Set Photo       Sensor    -->");
-			break;
-		
-		case Q4_2:
-			LCD_DisplayString(1, "4.Reading: ");
-			plant1.sunLevel = SUN_reading;
-			convertToDec(12, SUN_reading);
-			LCD_DisplayString(25, "SAVE -->");
-			break;
-			
-		case CONFIRM:
-			LCD_DisplayString(1, "Select Mem Slot 1,2,3,4?:");
-			if (input1234) {
-				LCD_Cursor(27);
-				memSlot = GetKeypadKey() - '0';
-				LCD_WriteData(memSlot + '0');
-			}
-			break;
-		
-		case WRITE:
-			for (signed char i = 0; i < 50; ++i) {
-				LCD_DisplayString(1, "Saving Profile..");
-			}
-			savePlantProfile(plant1, memSlot);
-			if (memSlot == 1) {
-				num = ONE;
-			}
-			else if (memSlot == 2) {
-				num = TWO;
-			}
-			else if (memSlot == 3) {
-				num = THREE;
-			}
-			else if (memSlot == 4) {
-				num = FOUR;
-			}
-			transmit_data(num);
-			LCD_ClearScreen();
-			break;
-			
-		case WRITE_MS:
-			for (signed char i = 0; i < 50; ++i) {
-				LCD_DisplayString(1, "Saving Profile..");
-			}
-			saveMS(plant1.moisture, memSlot);
-			LCD_ClearScreen();
-			break;
-			
-		case WRITE_SUN:
-			for (signed char i = 0; i < 50; ++i) {
-				LCD_DisplayString(1, "Saving Profile..");
-			}
-			saveMS(plant1.sunLevel, memSlot);
-			LCD_ClearScreen();
-			break;
-			
+void enterClearGotit() {
+	gotit = 0;
+}
+
+void drawScaler() {
+	LCD_DisplayString_P(21, (enableScaler == 1) ? txtYay : txtNay);
+}
+
+uchar pollScaler(uchar dir, uchar key) {
+	uchar want = (dir == DIR_UP) ? 1 : (dir == DIR_DOWN) ? 0 : enableScaler;
+	if (want == enableScaler) { return 0; }
+	enableScaler = want;
+	return 1;
+}
+
+void drawGlance1() {
+	LCD_DisplayString_P(14, (plant1.dayTimeWaterOK == 1) ? txtYes : txtNo);
+	convertToDec(28, plant1.waterFrequency);
+}
+
+void drawGlance2() {
+	convertToDec(4, plant1.moisture);
+	showBar(&barTop, 9, BAR_CELLS, plant1.moisture);
+	convertToDec(20, plant1.sunLevel);
+	showBar(&barBottom, 25, BAR_CELLS, plant1.sunLevel);
+}
+
+void enterReadings() {
+	Glyph_Put(1, GLYPH_DROP);
+	Glyph_Put(17, GLYPH_SUN);
+}
+
+void drawReadings() {
+	unsigned short ms, sun;
+	shownMS = MS_reading;
+	shownSun = SUN_reading;
+	ms = Cal_Apply(CAL_MS, shownMS);
+	sun = Cal_Apply(CAL_SUN, shownSun);
+	showBar(&barTop, 3, BAR_CELLS_WIDE, ms);
+	showBar(&barBottom, 19, BAR_CELLS_WIDE, sun);
+}
+
+uchar pollReadings(uchar dir, uchar key) {
+	return MS_reading != shownMS || SUN_reading != shownSun;
+}
+
+void enterCalibMS() {
+	plant1.moisture = Cal_Apply(CAL_MS, MS_reading);
+}
+
+void drawCalibMS() {
+	showBar(&barBottom, 17, BAR_CELLS, plant1.moisture);
+}
+
+uchar pollCalibMS(uchar dir, uchar key) {
+	unsigned short v = Cal_Apply(CAL_MS, MS_reading);
+	if (v == plant1.moisture) { return 0; }
+	plant1.moisture = v;
+	return 1;
+}
+
+void enterCalibSun() {
+	plant1.sunLevel = Cal_Apply(CAL_SUN, SUN_reading);
+}
+
+void drawCalibSun() {
+	showBar(&barBottom, 17, BAR_CELLS, plant1.sunLevel);
+}
+
+uchar pollCalibSun(uchar dir, uchar key) {
+	unsigned short v = Cal_Apply(CAL_SUN, SUN_reading);
+	if (v == plant1.sunLevel) { return 0; }
+	plant1.sunLevel = v;
+	return 1;
+}
+
+uchar pollSlotKey(uchar dir, uchar key) {
+	if (key < '1' || key > '4' || (gotit == 1 && memSlot == key - '0')) { return 0; }
+	memSlot = key - '0';
+	gotit = 1;
+	return 1;
+}
+
+void drawSourceSlot() {
+	if (gotit == 1) {
+		LCD_Cursor(27);
+		LCD_WriteData(memSlot + '0');
+	}
+}
+
+void drawTargetSlot() {
+	if (memSlot != 0) {
+		LCD_Cursor(27);
+		LCD_WriteData(memSlot + '0');
+	}
+}
+
+void enterRetrieve() {
+	retrievePlantProfile(memSlot);
+	showSlot();
+}
+
+void drawSetting1() {
+	if (plant1.dayTimeWaterOK == 1) {
+		LCD_DisplayString_P(17, txtYes);
+	}
+	else if (plant1.dayTimeWaterOK == 0) {
+		LCD_DisplayString_P(17, txtNo);
+	}
+}
+
+void drawSetting2() {
+	Fmt_U16(fbuf, plant1.waterFrequency, 1, ' ', 0);
+	LCD_DisplayString(13, fbuf);
+}
+
+void drawSetting3() {
+	convertToDec(17, plant1.moisture);
+}
+
+void drawSetting4() {
+	convertToDec(17, plant1.sunLevel);
+}
+
+void drawSetting5() {
+	uchar buf[FMT_U16_MAX + 4];
+	Fmt_U16(buf, Profile_WaterMs(&plant1), 1, ' ', " ms");
+	LCD_DisplayString(17, buf);
+}
+
+void enterQ1() {
+	answer = txtBlank;
+	gotit = 0;
+}
+
+// The scrolling prompts keep their answers past their own length on row 2,
+// in view at every shift (viewport.h)
+
+void drawQ1() {
+	LCD_DisplayString_P(28, answer);
+}
+
+uchar pollQ1(uchar dir, uchar key) {
+	const char *was = answer;
+	if (key == 'A') {
+		answer = txtYes;
+		plant1.dayTimeWaterOK = 1;
+		gotit = 1;
+	}
+	else if (key == 'B') {
+		answer = txtNoPad;
+		plant1.dayTimeWaterOK = 0;
+		gotit = 1;
+	}
+	else if (key == '*') {
+		answer = txtBlank;
+	}
+	return answer != was;
+}
+
+void drawQ2() {
+	if (gotit == 1) {
+		Fmt_U16(fbuf, plant1.waterFrequency, 1, ' ', 0);
+		LCD_DisplayString(29, fbuf);
+	}
+}
+
+uchar pollQ2(uchar dir, uchar key) {
+	uchar freq;
+	if (key == '\0' || (key >= 'A' && key <= 'D') || key == '#') { return 0; }
+	/* for Demo: special key to set frequency to 1 min, can show reseting/watering */
+	freq = (key == '*') ? ZONE_DEMO_FREQ : key - '0';
+	if (gotit == 1 && freq == plant1.waterFrequency) { return 0; }
+	plant1.waterFrequency = freq;
+	gotit = 1;
+	return 1;
+}
+
+void enterPulse() {
+	pulseTenths = 0;
+	lastKey = '\0';
+	gotit = 0;
+}
+
+void drawPulse() {
+	Fmt_U16(fbuf, pulseTenths, 3, ' ', 0);
+	LCD_DisplayString(26, fbuf);
+}
+
+uchar pollPulse(uchar dir, uchar key) {
+	uchar was = lastKey;
+	unsigned short v;
+	lastKey = key;
+	if (key == was) { return 0; }		// one digit per press, not per tick held
+	if (key == '*') {
+		pulseTenths = 0;
+		gotit = 0;
+		return 1;
+	}
+	if (key < '0' || key > '9') { return 0; }
+	v = pulseTenths * 10 + (key - '0');
+	if (v > PROFILE_WATER_MAX / 100) { return 0; }
+	pulseTenths = v;
+	plant1.waterMs = v * 100;
+	gotit = (v != 0);
+	return 1;
+}
+
+void enterWrite() {
+	savePlantProfile(plant1, memSlot);
+	showSlot();
+}
+
+void enterWriteMS() {
+	saveMS(plant1.moisture, memSlot);
+}
+
+void enterWriteSun() {
+	saveSun(plant1.sunLevel, memSlot);
+}
+
+void drawDiag() {
+	shownPeak = stackPeak;
+	Fmt_U16(fbuf, shownPeak, 5, ' ', 0);
+	LCD_DisplayString(12, fbuf);
+	Fmt_U16(fbuf, StackMon_Free(), 5, ' ', 0);
+	LCD_DisplayString(28, fbuf);
+}
+
+uchar pollDiag(uchar dir, uchar key) {
+	return stackPeak != shownPeak;
+}
+
+unsigned short curveRaw() {
+	return (curveSensor == CAL_MS) ? MS_reading : SUN_reading;
+}
+
+void enterCurveSensor() {
+	curveSensor = CAL_MS;
+}
+
+void drawCurveSensor() {
+	LCD_DisplayString_P(17, (curveSensor == CAL_MS) ? txtCurveMS : txtCurveSun);
+}
+
+uchar pollCurveSensor(uchar dir, uchar key) {
+	uchar want = (dir == DIR_UP) ? CAL_MS : (dir == DIR_DOWN) ? CAL_SUN : curveSensor;
+	if (want == curveSensor) { return 0; }
+	curveSensor = want;
+	return 1;
+}
+
+void enterCurvePoint() {
+	curve.n = 0;
+	curveRef = 0;
+	lastKey = '\0';
+}
+
+void drawCurvePoint() {
+	shownRaw = curveRaw();
+	Fmt_U16(fbuf, shownRaw, 4, '0', 0);
+	LCD_DisplayString(6, fbuf);
+	LCD_Cursor(15);
+	LCD_WriteData(curve.n + '0');
+	Fmt_U16(fbuf, curveRef, 3, ' ', 0);
+	LCD_DisplayString(24, fbuf);
+}
+
+uchar addCurvePoint() {
+	unsigned short raw = curveRaw();
+	uchar i;
+	if (curve.n >= CAL_POINTS) { return 0; }
+	for (i = 0; i < curve.n; ++i) {
+		if (curve.raw[i] == raw) { return 0; }	// one reference per reading
+	}
+	curve.raw[curve.n] = raw;
+	curve.val[curve.n] = curveRef * (CAL_FULL / 100);
+	++curve.n;
+	curveRef = 0;
+	return 1;
+}
+
+uchar pollCurvePoint(uchar dir, uchar key) {
+	uchar was = lastKey;
+	unsigned short v;
+	lastKey = key;
+	if (key != was) {						// one digit per press, not per tick held
+		if (key == 'A') { return addCurvePoint(); }
+		if (key == '*') {
+			curveRef = 0;
+			return 1;
+		}
+		if (key >= '0' && key <= '9') {
+			v = curveRef * 10 + (key - '0');
+			if (v <= 100) {
+				curveRef = v;
+				return 1;
+			}
+		}
+	}
+	return curveRaw() != shownRaw;
+}
+
+uchar readyCurve() {
+	return curve.n >= 2;
+}
+
+void enterCurveSave() {
+	Cal_Put(curveSensor, &curve);
+}
+
+/* ----------  SCREEN TABLE  ---------- */
+
+#define GOTO(s) { s, s, s, s, s }
+
+const Screen screens[NUM_STATES] PROGMEM = {
+	/*                  NONE            UP            DOWN          LEFT          RIGHT */
+	[WELCOME]        = { { WELCOME,       WELCOME,      MENU_SET,     WELCOME,      WELCOME      }, txtWelcome,    0, 0, 0, 0, 0 },
+	[SETTINGS]       = { { SETTINGS,      SETTINGS,     SETTINGS,     SETTINGS,     MENU_SET     }, txtScaler,     0, drawScaler, pollScaler, 0, MENU_DEP_DIR },
+	[MENU_SET]       = { { MENU_SET,      MENU_SET,     MENU_LOAD,    SETTINGS,     Q1           }, txtMenuSet,    0, 0, 0, 0, 0 },
+	[MENU_LOAD]      = { { MENU_LOAD,     MENU_SET,     MENU_DATA,    SETTINGS,     READFROM     }, txtMenuLoad,   0, 0, 0, 0, 0 },
+	[MENU_DATA]      = { { MENU_DATA,     MENU_LOAD,    MENU_GLANCE,  MENU_DATA,    TAKE_READING }, txtMenuData,   0, 0, 0, 0, 0 },
+	[MENU_GLANCE]    = { { MENU_GLANCE,   MENU_DATA,    MENU_CALMS,   MENU_GLANCE,  GLANCE1      }, txtMenuGlance, 0, 0, 0, 0, 0 },
+	[MENU_CALMS]     = { { MENU_CALMS,    MENU_GLANCE,  MENU_CALSUN,  MENU_CALMS,   CALIB_MS     }, txtMenuCalMS,  0, 0, 0, 0, 0 },
+	[MENU_CALSUN]    = { { MENU_CALSUN,   MENU_CALMS,   MENU_CURVE,   MENU_CALSUN,  CALIB_SUN    }, txtMenuCalSun, 0, 0, 0, 0, 0 },
+	[MENU_CURVE]     = { { MENU_CURVE,    MENU_CALSUN,  MENU_DIAG,    MENU_CURVE,   CURVE_SENSOR }, txtMenuCurve,  0, 0, 0, 0, 0 },
+	[MENU_DIAG]      = { { MENU_DIAG,     MENU_CURVE,   MENU_DIAG,    MENU_DIAG,    DIAG         }, txtMenuDiag,   0, 0, 0, 0, 0 },
+	[GLANCE1]        = { { GLANCE1,       GLANCE2,      GLANCE2,      MENU_GLANCE,  GLANCE1      }, txtGlance1,    0, drawGlance1, 0, 0, 0 },
+	[GLANCE2]        = { { GLANCE2,       GLANCE1,      GLANCE1,      MENU_GLANCE,  GLANCE2      }, txtGlance2,    0, drawGlance2, 0, 0, 0 },
+	[TAKE_READING]   = { { TAKE_READING,  MENU_SET,     TAKE_READING, MENU_DATA,    TAKE_READING }, 0,             enterReadings, drawReadings, pollReadings, 0, MENU_DEP_SENSOR },
+	[CALIB_SUN]      = { { CALIB_SUN,     MENU_SET,     CALIB_SUN,    MENU_CALSUN,  CALIB_SUN2   }, txtSetPhoto1,  0, 0, 0, 0, 0 },
+	[CALIB_SUN2]     = { { CALIB_SUN2,    MENU_SET,     CALIB_SUN2,   CALIB_SUN,    WRITE_SUN    }, txtCalib2,     enterCalibSun, drawCalibSun, pollCalibSun, 0, MENU_DEP_SENSOR },
+	[CALIB_MS]       = { { CALIB_MS,      MENU_SET,     CALIB_MS,     MENU_CALMS,   CALIB_MS2    }, txtPlaceMS1,   0, 0, 0, 0, 0 },
+	[CALIB_MS2]      = { { CALIB_MS2,     MENU_SET,     CALIB_MS2,    CALIB_MS,     WRITE_MS     }, txtCalib2,     enterCalibMS, drawCalibMS, pollCalibMS, 0, MENU_DEP_SENSOR },
+	[UPDATE_PROFILE] = { GOTO(MENU_SET),                                                           0,             0, 0, 0, 0, 0 },
+	[Q1]             = { { Q1,            MENU_SET,     Q1,           MENU_SET,     Q2           }, txtQ1,         enterQ1, drawQ1, pollQ1, readyGotit, MENU_DEP_KEY, MENU_SCROLL },
+	[Q2]             = { { Q2,            MENU_SET,     Q2,           Q1,           Q2_2         }, txtQ2,         enterClearGotit, drawQ2, pollQ2, readyGotit, MENU_DEP_KEY, MENU_SCROLL },
+	[Q2_2]           = { { Q2_2,          MENU_SET,     Q2_2,         Q2,           Q3_1         }, txtQPulse,     enterPulse, drawPulse, pollPulse, readyGotit, MENU_DEP_KEY },
+	[Q3_1]           = { { Q3_1,          MENU_SET,     Q3_1,         Q2_2,         Q3_2         }, txtPlaceMS1,   0, 0, 0, 0, 0 },
+	[Q3_2]           = { { Q3_2,          MENU_SET,     Q3_2,         Q3_1,         Q4_1         }, txtCalib2,     enterCalibMS, drawCalibMS, pollCalibMS, 0, MENU_DEP_SENSOR },
+	[Q4_1]           = { { Q4_1,          MENU_SET,     Q4_1,         Q3_1,         Q4_2         }, txtSetPhoto3,  0, 0, 0, 0, 0 },
+	[Q4_2]           = { { Q4_2,          MENU_SET,     Q4_2,         Q4_1,         CONFIRM      }, txtCalib4,     enterCalibSun, drawCalibSun, pollCalibSun, 0, MENU_DEP_SENSOR },
+	[CONFIRM]        = { { CONFIRM,       MENU_SET,     CONFIRM,      Q4_2,         WRITE        }, txtSelectSlot, 0, drawTargetSlot, pollSlotKey, readySlot, MENU_DEP_KEY, MENU_SCROLL },
+	[WRITE]          = { GOTO(MENU_SET),                                                           txtSaving,     enterWrite, 0, 0, 0, 0 },
+	[WRITE_MS]       = { GOTO(MENU_SET),                                                           txtSaving,     enterWriteMS, 0, 0, 0, 0 },
+	[WRITE_SUN]      = { GOTO(MENU_SET),                                                           txtSaving,     enterWriteSun, 0, 0, 0, 0 },
+	[READFROM]       = { { READFROM,      MENU_SET,     READFROM,     MENU_LOAD,    RETRIEVE     }, txtSourceSlot, enterClearGotit, drawSourceSlot, pollSlotKey, readyGotit, MENU_DEP_KEY, MENU_SCROLL },
+	[RETRIEVE]       = { GOTO(SETTING1),                                                           0,             enterRetrieve, 0, 0, 0, 0 },
+	[SETTING1]       = { { SETTING1,      SETTING5,     SETTING2,     MENU_SET,     SETTING1     }, txtWaterDay,   0, drawSetting1, 0, 0, 0 },
+	[SETTING2]       = { { SETTING2,      SETTING1,     SETTING3,     MENU_SET,     SETTING2     }, txtWaterEvery, 0, drawSetting2, 0, 0, 0 },
+	[SETTING3]       = { { SETTING3,      SETTING2,     SETTING4,     MENU_SET,     SETTING3     }, txtMSThresh,   0, drawSetting3, 0, 0, 0 },
+	[SETTING4]       = { { SETTING4,      SETTING3,     SETTING5,     MENU_SET,     SETTING4     }, txtSunThresh,  0, drawSetting4, 0, 0, 0 },
+	[SETTING5]       = { { SETTING5,      SETTING4,     SETTING1,     MENU_SET,     SETTING5     }, txtPulseLen,   0, drawSetting5, 0, 0, 0 },
+	[DIAG]           = { { DIAG,          MENU_SET,     DIAG,         MENU_DIAG,    DIAG         }, txtDiag,       0, drawDiag, pollDiag, 0, MENU_DEP_STACK },
+	[CURVE_SENSOR]   = { { CURVE_SENSOR,  CURVE_SENSOR, CURVE_SENSOR, MENU_CURVE,   CURVE_POINT  }, txtCurveFor,   enterCurveSensor, drawCurveSensor, pollCurveSensor, 0, MENU_DEP_DIR },
+	[CURVE_POINT]    = { { CURVE_POINT,   MENU_SET,     CURVE_POINT,  CURVE_SENSOR, CURVE_SAVE   }, txtCurvePoint, enterCurvePoint, drawCurvePoint, pollCurvePoint, readyCurve, MENU_DEP_KEY | MENU_DEP_SENSOR },
+	[CURVE_SAVE]     = { GOTO(MENU_CURVE),                                                         txtSavingCurve, enterCurveSave, 0, 0, 0, 0 },
+};
+
+/* ----------  UI TASK  ---------- */
+
+// The UI task drops to UI_IDLE_PERIOD once nobody has touched the device for
+// UI_IDLE_TICKS ticks on a screen that shows nothing live or scrolling;
+// reader() wakes it on the first input. The idle period stays under
+// WARM_WDTO, as the watchdog is only fed once every task has ticked.
+#define UI_PERIOD      300
+#define UI_IDLE_PERIOD 1200
+#define UI_IDLE_TICKS  20
+
+task* uiTask;
+uchar uiIdle;
+uchar seenKey;
+unsigned short seenMS;
+unsigned short seenSun;
+unsigned short seenPeak;
+
+uchar uiChanged(uchar dir, uchar key) {
+	uchar changed = (dir != DIR_NONE) ? MENU_DEP_DIR : 0;
+	if (key != seenKey) {
+		seenKey = key;
+		changed |= MENU_DEP_KEY;
+	}
+	if (MS_reading != seenMS || SUN_reading != seenSun) {
+		seenMS = MS_reading;
+		seenSun = SUN_reading;
+		changed |= MENU_DEP_SENSOR;
+	}
+	if (stackPeak != seenPeak) {
+		seenPeak = stackPeak;
+		changed |= MENU_DEP_STACK;
+	}
+	return changed;
+}
+
+void wakeUi() {
+	uiIdle = 0;
+	if (uiTask->period == UI_PERIOD) { return; }
+	uiTask->period = UI_PERIOD;
+	uiTask->elapsedTime = UI_PERIOD;	// runs later in this round
+}
+
+int ss(int state) {
+	uchar dir, key, scrolling;
+
+	if (!bootLcdReady) { return state; }
+	if (state < 0 || state >= NUM_STATES) {
+		// WELCOME on a cold boot, the screen that was up after a warm restart
+		stater = Menu_Enter(screens, (stater < NUM_STATES) ? stater : WELCOME);
+		Display_Flush();
+		Boot_Stamp(BOOT_UI);
+		return stater;
 	}
+	dir = readDirection();
+	key = readKey();
+	stater = Menu_Step(screens, state, dir, key, uiChanged(dir, key));
+	scrolling = View_Step();
+	Display_Flush();
+	if (dir != DIR_NONE || key != '\0' || stater != state) { uiIdle = 0; }
+	else if (uiIdle < UI_IDLE_TICKS) { ++uiIdle; }
+	else if (!scrolling && !(Menu_Deps(screens, stater) & MENU_DEP_LIVE)) { uiTask->period = UI_IDLE_PERIOD; }
 	return stater;
 }
 
@@ -919,7 +662,15 @@ enum {
 	UPDATE
 } ADC_state;
 
+void readSensors() {
+	Zone_Snapshot();
+	MS_reading = adcValue[zoneMsChannel[0]];
+	SUN_reading = adcValue[zoneSunChannel[0]];
+}
+
 int reader() {
+	uchar cmd;
+
 	switch(ADC_state) {
 		case READ:
 			//ADC_state = UPDATE;
@@ -933,8 +684,19 @@ int reader() {
 	switch(ADC_state) {
 		case READ:
 			readJoystick();
-			readMoisture();
-			readSun();
+			if (readDirection() != DIR_NONE || keyHeld()) { wakeUi(); }
+			readSensors();
+			if (USART_HasReceived(CONSOLE_USART)) {
+				cmd = USART_Receive(CONSOLE_USART);
+				if (Update_Match(cmd)) { Update_Request(); }
+				else if (cmd == 'H' && !traceHeld) { History_DumpStart(); }
+				else if (cmd == 'S') { StackMon_Report(); }
+				else if (cmd == 'B') { Boot_Report(); }
+				else if (cmd == 'T' && !histDumping) { Trace_DumpStart(); }
+			}
+			// dumps go out a chunk per tick, so the other tasks keep their time
+			Trace_DumpStep();
+			History_DumpStep();
 			//if (cc % 2 == 0) {
 				//PORTD = SetBit(PORTD, 0, 1);
 			//}
@@ -953,86 +715,47 @@ int reader() {
 	return ADC_state;
 }
 
-enum {
-	TICK,
-	WATER_PLANT,
-	RESET
-} elon_musk;
-
-uchar frequency;
-uchar t;
-uchar sec;
-uchar half;
-uchar min;
-uchar day;
-
-/* 1 day --> 86,400
-   7 days -> 604,800
-
-unsigned long 4 bytes
-4,294,967,295 seconds --> 49,710 days
-*/
-
-int hourGlass() {
-	switch(elon_musk) {
-		case TICK:
-			if (frequency != plant1.waterFrequency) {
-				PORTD = SetBit(PORTD, 1, 0);
-				// meaning a plant profile has changed/switched
-				elon_musk = RESET;
-			}
-			//if (frequency == 99 && min == 1) {
-			if (frequency == 99 && min == 1 && (plant1.dayTimeWaterOK == 1 || (plant1.dayTimeWaterOK == 0 && SUN_reading < plant1.sunLevel)) && MS_reading < plant1.moisture) {
-				elon_musk = WATER_PLANT;
-			}
-			if (OK_TO_WATER) {
-				elon_musk = WATER_PLANT;
-			}
-			break;
-
-		case WATER_PLANT:
-			elon_musk = RESET;
-			break;
+uchar watered;
 
-		case RESET:
-			elon_musk = TICK;
-			break;
+int hourGlass(int state) {
+	QueueEvent ev;
+	zonemask_t started;
 
-		default:
-			t = sec = half = min = day = 0;
-			frequency = plant1.waterFrequency;
-			elon_musk = TICK;
-			break;
+	while (Queue_Get(&zoneEvents, &ev)) {
+		History_Event((ev.type == ZONE_EV_LIMIT) ? HIST_EV_WATER_LIMIT : HIST_EV_WATER_END, ev.arg);
 	}
+	started = Zone_Tick();
+	if (started) {
+		watered = 1;
+		History_Event(HIST_EV_WATER, started);
+	}
+	History_Tick(MS_reading, SUN_reading);
+	StackMon_Scan();
+	if (watered) { SET_BIT(WATERED_PORT, WATERED_BIT); } else { CLR_BIT(WATERED_PORT, WATERED_BIT); }
+	return state;
+}
 
-	switch(elon_musk) {
-		case TICK:
-			if (t > 9) { /* a second has gone by*/
-				t = 0;
-				++sec;
-			}
-			else if (sec > 50) { /* 60 seconds have gone by */
-				sec = 0;
-				++min;
-			}
-			else if (min > 1439) {
-				min = 0;
-				++day;
-			}
-			++t;
-			break;
-
-		case WATER_PLANT:
-			PORTD = SetBit(PORTD, 1, 1);
-			break;
+void msTick() {
+	if (!bootLcdReady) { Boot_LcdTick(); }
+	if (Sensor_Tick()) { Zone_Sample(); }
+	Zone_Control();
+}
 
-		case RESET:
-			PORTD = SetBit(PORTD, 0, 1);
-			frequency = plant1.waterFrequency;
-			t = sec = min = day = 0;
-			break;
-	}
+void saveWarm() {
+	warm.screen = stater;
+	warm.memSlot = memSlot;
+	warm.scaler = enableScaler;
+	warm.watered = watered;
+	warm.plant = plant1;
+	Warm_Save();
+}
 
+void restoreWarm() {
+	stater = warm.screen;
+	memSlot = warm.memSlot;
+	enableScaler = warm.scaler;
+	watered = warm.watered;
+	plant1 = warm.plant;
 }
 
 
@@ -1043,11 +766,33 @@ int main(void)
 	DDRC = 0xFF; PORTC = 0x00;
 	DDRD = 0xFF; PORTD = 0x00;
 	
+	// The timer runs from here on; tasks start once tasksNum is set below
+	TimerSet(100); // value set should be GCD of all tasks
+	TimerOn();
+	Valve_Init();
+	Sensor_Init();
+	Boot_Stamp(BOOT_TIMER);
+	uchar resumed = Warm_Restore();
+	Boot_StartLcd(resumed);	// still set up if the watchdog reset us
+	Display_Init();
+	tasksMsFct = &msTick;
+	
 	ADC_init();
-	LCD_init();
+	Boot_Stamp(BOOT_ADC);
+	Profile_LoadCache();
+	Cal_Load();
+	Boot_Stamp(BOOT_PROFILES);
+	if (resumed) { restoreWarm(); }
+	Zone_Init();
+	Boot_Stamp(BOOT_ZONES);
+	Zone_Sample();
+	readSensors();
+	Boot_Stamp(BOOT_SAMPLE);
+	History_Init();
+	Boot_Stamp(BOOT_HISTORY);
+	initUSART(CONSOLE_USART);
 	
-	tasksNum = 3;
-	task tsks[tasksNum];
+	task tsks[3];
 	tasks = tsks;
 	
 	uchar i = 0;
@@ -1067,12 +812,16 @@ int main(void)
 	++i;
 
 	tasks[i].state = -1;
-	tasks[i].period = 300;
-	tasks[i].elapsedTime = tasks[i].period;
+	tasks[i].period = UI_PERIOD;
+	tasks[i].elapsedTime = tasks[i].period - 100;	// first tick at 200 ms, after the LCD is up
 	tasks[i].TickFct = &ss;
+	uiTask = &tasks[i];
 	
-	TimerSet(100); // value set should be GCD of all tasks
-	TimerOn();
+	tasksNum = 3;
+	Boot_Stamp(BOOT_TASKS);
+	tasksRoundFct = &saveWarm;
+	wdt_enable(WARM_WDTO);
 	
-	while(1) {} // task scheduler will be called by the hardware interrupt
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	while(1) { sleep_mode(); } // task scheduler will be called by the hardware interrupt
 }
\ No newline at end of file